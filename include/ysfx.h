@@ -98,6 +98,32 @@ YSFX_API void ysfx_register_builtin_audio_formats(ysfx_config_t *config);
 YSFX_API void ysfx_set_log_reporter(ysfx_config_t *config, ysfx_log_reporter_t *reporter);
 // set the callback user data
 YSFX_API void ysfx_set_user_data(ysfx_config_t *config, intptr_t userdata);
+// map named gmem namespaces onto shared memory, visible to other processes
+//   the first instance to attach a namespace in the process decides its backend
+//   returns false if the platform does not support it
+YSFX_API bool ysfx_set_shared_gmem(ysfx_config_t *config, bool shared);
+// remove the shared memory object of a named gmem namespace
+//   shared namespaces persist after all the processes using them have exited,
+//   with the memory they have touched, until they are removed with this
+//   the processes which have it mapped keep their view, later ones start from zero
+//   returns false if there is no such object, or the platform does not support it
+YSFX_API bool ysfx_unlink_shared_gmem(const char *name);
+// set the number of files which an effect can have open at once, 64 by default
+//   it applies to the effects created afterwards with this configuration
+YSFX_API void ysfx_set_max_file_handles(ysfx_config_t *config, uint32_t count);
+// set the memory budget of the process-wide cache of decoded audio files, in bytes
+//   audio files which fit are decoded whole in the background, and shared across
+//   effects; a file which is not decoded yet when opened is read as it goes
+//   the budget is not part of the configuration, since one cache serves the
+//   effects of every configuration
+//   0 disables the cache, and the files are decoded as they are read
+YSFX_API void ysfx_set_audio_cache_budget(uint64_t bytes);
+// set the memory budget of the process-wide cache of decoded images, in bytes
+//   images loaded by @gfx are shared across effects until they are drawn into
+//   the budget is not part of the configuration, since one cache serves the
+//   effects of every configuration
+//   0 disables the cache, and each effect decodes its own images
+YSFX_API void ysfx_set_image_cache_budget(uint64_t bytes);
 
 // get a string which textually represents the log level
 YSFX_API const char *ysfx_log_level_string(ysfx_log_level level);
@@ -329,6 +355,10 @@ YSFX_API bool ysfx_send_midi(ysfx_t *fx, const ysfx_midi_event_t *event);
 YSFX_API bool ysfx_receive_midi(ysfx_t *fx, ysfx_midi_event_t *event);
 // receive MIDI from a single bus (do not mix with API above, use either)
 YSFX_API bool ysfx_receive_midi_from_bus(ysfx_t *fx, uint32_t bus, ysfx_midi_event_t *event);
+// send an array of MIDI events; returns how many were accepted, skipping those which are rejected
+YSFX_API uint32_t ysfx_send_midi_batch(ysfx_t *fx, const ysfx_midi_event_t *events, uint32_t count);
+// receive up to `count` MIDI events, after having processed the cycle; returns how many were received
+YSFX_API uint32_t ysfx_receive_midi_batch(ysfx_t *fx, ysfx_midi_event_t *events, uint32_t count);
 
 // send a trigger, it will be processed during the cycle
 YSFX_API bool ysfx_send_trigger(ysfx_t *fx, uint32_t index);
@@ -348,6 +378,12 @@ YSFX_API uint64_t ysfx_fetch_slider_touches(ysfx_t *fx, uint8_t slider_group_ind
 YSFX_API uint64_t ysfx_get_slider_visibility(ysfx_t *fx, uint8_t slider_group_index);
 // determine whether the plugin wants a manual undo point made and clear it to false
 YSFX_API bool ysfx_fetch_want_undopoint(ysfx_t *fx);
+// get a counter which increases whenever the state of the effect may have changed
+//   it does not run @serialize, instead it checks the sliders, the variables, and
+//   the memory which the last `ysfx_save_state` has saved; if @serialize might
+//   read other memory, the counter increases on every call. The built-in variables
+//   are only checked when @serialize saves them directly, not through another one.
+YSFX_API uint64_t ysfx_get_state_generation(ysfx_t *fx);
 
 // process a cycle in 32-bit float
 YSFX_API void ysfx_process_float(ysfx_t *fx, const float *const *ins, float *const *outs, uint32_t num_ins, uint32_t num_outs, uint32_t num_frames);
@@ -430,6 +466,17 @@ typedef int (ysfx_enum_vars_callback_t)(const char *name, ysfx_real *var, void *
 YSFX_API void ysfx_enum_vars(ysfx_t *fx, ysfx_enum_vars_callback_t *callback, void *userdata);
 // find a single variable in the VM
 YSFX_API ysfx_real *ysfx_find_var(ysfx_t *fx, const char *name);
+
+typedef enum ysfx_var_search_mode_e {
+    // names which begin with the pattern
+    ysfx_var_search_prefix,
+    // names which contain the pattern
+    ysfx_var_search_substring,
+} ysfx_var_search_mode_t;
+
+// enumerate the variables whose name matches a pattern, ignoring case, in name order
+//   the search uses the index built at compilation, and an empty pattern matches all
+YSFX_API void ysfx_search_vars(ysfx_t *fx, const char *pattern, ysfx_var_search_mode_t mode, ysfx_enum_vars_callback_t *callback, void *userdata);
 // read a single value from a variable in the VM
 YSFX_API ysfx_real ysfx_read_var(ysfx_t *fx, const char *name);
 // read a chunk of virtual memory from the VM
@@ -439,6 +486,39 @@ YSFX_API ysfx_real ysfx_read_vmem_single(ysfx_t *fx, uint32_t addr);
 // read how many memory slots are in use
 YSFX_API int ysfx_calculate_used_mem(ysfx_t *fx);
 
+typedef struct ysfx_memory_stats_s {
+    // bytes of VM memory allocated, in whole blocks
+    uint64_t vm_bytes;
+    // bytes of gmem allocated in the attached namespace, in whole blocks
+    //   it is 0 for the default gmem, and for a namespace in shared memory
+    uint64_t gmem_bytes;
+    // bytes of text held in strings, only counted with `ysfx_memory_stats_strings`
+    uint64_t string_bytes;
+    // bytes of pixels held in gfx images
+    uint64_t image_bytes;
+    // number of open file handles
+    uint32_t file_handles;
+} ysfx_memory_stats_t;
+
+typedef enum ysfx_memory_stats_flag_e {
+    // count the bytes of strings; it goes through all of them under the lock
+    // of strings, which holds up the DSP thread if it uses strings meanwhile
+    ysfx_memory_stats_strings = 1 << 0,
+} ysfx_memory_stats_flag_t;
+
+// get the memory usage of the effect
+//   without flags, it only reads counters, and it is suitable to call
+//   periodically from the UI
+//   `flags` is a combination of `ysfx_memory_stats_flag_t`
+YSFX_API void ysfx_get_memory_stats(ysfx_t *fx, uint32_t flags, ysfx_memory_stats_t *stats);
+// save the named gmem namespace of the effect to a snapshot file, tagged with a version
+YSFX_API bool ysfx_save_gmem_snapshot(ysfx_t *fx, const char *path, uint64_t version);
+// restore the named gmem namespace of the effect from a snapshot file
+//   the snapshot must match the namespace and the version, and the namespace must
+//   not hold any memory yet (ie. call this after compiling and before init)
+//   where possible, the file is mapped into memory copy-on-write, rather than read
+YSFX_API bool ysfx_load_gmem_snapshot(ysfx_t *fx, const char *path, uint64_t version);
+
 //------------------------------------------------------------------------------
 // YSFX graphics
 
@@ -480,6 +560,19 @@ YSFX_API void ysfx_gfx_update_mouse(ysfx_t *fx, uint32_t mods, int32_t xpos, int
 YSFX_API void ysfx_gfx_set_window_state(ysfx_t *fx, bool hasFocus, bool windowVisible, bool mouseOver);
 // invoke @gfx to paint the graphics; returns whether the framer buffer is modified
 YSFX_API bool ysfx_gfx_run(ysfx_t *fx);
+
+typedef struct ysfx_gfx_rect_s {
+    int32_t x;
+    int32_t y;
+    int32_t w;
+    int32_t h;
+} ysfx_gfx_rect_t;
+
+// get the areas of the frame buffer modified by the last `ysfx_gfx_run`, in pixels
+//   fills up to `max` rectangles, and returns the total count, which is 0 if none
+//   the rectangles do not overlap, and they are few; when many areas are drawn,
+//   they are merged into larger ones, up to the entire frame buffer
+YSFX_API uint32_t ysfx_gfx_get_dirty_rects(ysfx_t *fx, ysfx_gfx_rect_t *rects, uint32_t max);
 // request desired frame rate for UI refresh
 YSFX_API uint32_t ysfx_get_requested_framerate(ysfx_t *fx);
 
@@ -32,6 +32,13 @@
 #include <condition_variable>
 #include <cmath>
 #include <cstdio>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define YSFX_GFX_HAVE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#   include <arm_neon.h>
+#   define YSFX_GFX_HAVE_NEON 1
+#endif
 
 struct YsfxGraphicsView::Impl final : public better::AsyncUpdater::Listener {
     static uint32_t translateKeyCode(int code);
@@ -126,12 +133,44 @@ struct YsfxGraphicsView::Impl final : public better::AsyncUpdater::Listener {
     // The background thread will trigger these async updates.
 
     // sends a bitmap the component should repaint itself with
+    //
+    // The copies of the render bitmap form a triple buffer. The background
+    // thread fills the back one, and exchanges it with the middle one; the
+    // component takes the middle one for display when it is newer than its
+    // own. Neither side waits on the other to finish with the pixels.
     struct AsyncRepainter : public better::AsyncUpdater {
-        // whether the bitmap contains changes
-        bool m_hasBitmapChanged = false;
-        // a double-buffer of the render bitmap, copied after a finished rendering
-        juce::Image m_bitmap{juce::Image::ARGB, 1, 1, false, juce::SoftwareImageType{}};
-        std::mutex m_mutex;
+        enum { freshBit = 4 };
+        juce::Image m_bitmaps[3] = {
+            juce::Image{juce::Image::ARGB, 1, 1, true, juce::SoftwareImageType{}},
+            juce::Image{juce::Image::ARGB, 1, 1, true, juce::SoftwareImageType{}},
+            juce::Image{juce::Image::ARGB, 1, 1, true, juce::SoftwareImageType{}},
+        };
+        // the index of the middle bitmap, with `freshBit` if not yet displayed
+        std::atomic<int> m_middle{1};
+        // the index of the displayed bitmap, owned by the component
+        int m_front = 0;
+        // the index of the bitmap being filled, owned by the background thread
+        int m_back = 2;
+        // for each bitmap, the areas where it is behind the render bitmap,
+        // owned by the background thread
+        juce::RectangleList<int> m_stale[3];
+
+        // the areas of the bitmap changed since the last repaint, in pixels
+        juce::RectangleList<int> m_dirtyRegion;
+        std::mutex m_dirtyMutex;
+
+        // take the newest bitmap, if any, and return the one to display
+        const juce::Image &acquireFront()
+        {
+            if (m_middle.load(std::memory_order_relaxed) & freshBit)
+                m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~freshBit;
+            return m_bitmaps[m_front];
+        }
+        // make the back bitmap the newest, and get another to fill
+        void publishBack()
+        {
+            m_back = m_middle.exchange(m_back | freshBit, std::memory_order_acq_rel) & ~freshBit;
+        }
     };
 
     // changes the mouse cursor on the component
@@ -312,8 +351,7 @@ void YsfxGraphicsView::paint(juce::Graphics &g)
     } else {
         g.setImageResamplingQuality(juce::Graphics::highResamplingQuality);
     }
-    std::lock_guard<std::mutex> lock{m_impl->m_asyncRepainter->m_mutex};
-    juce::Image &image = m_impl->m_asyncRepainter->m_bitmap;
+    const juce::Image &image = m_impl->m_asyncRepainter->acquireFront();
 
     g.setOpacity(1.0f);
     auto trafo = juce::AffineTransform::scale(m_outputScalingFactor.load() / m_pixelFactor.load());
@@ -582,6 +620,7 @@ void YsfxGraphicsView::Impl::tickGfx()
     ysfx_add_ref(fx);
     msg->m_target = m_gfxTarget;
     msg->m_dirty = m_gfxDirty;
+    m_gfxDirty = false;
     msg->m_input.m_ysfxMouseMods = m_gfxInputState->m_ysfxMouseMods;
     msg->m_input.m_ysfxMouseButtons = m_gfxInputState->m_ysfxMouseButtons;
     msg->m_input.m_ysfxMouseX = m_gfxInputState->m_ysfxMouseX;
@@ -864,6 +903,37 @@ std::shared_ptr<YsfxGraphicsView::Impl::BackgroundWork::Message> YsfxGraphicsVie
     return msg;
 }
 
+// copy pixels and set their alpha channel to 255, since JSFX do not care for it
+static void copyOpaquePixels(const juce::uint32 *src, juce::uint32 *dst, int count)
+{
+    int i = 0;
+
+#if defined(YSFX_GFX_HAVE_SSE2)
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 12));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(a, alpha));
+        _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_or_si128(b, alpha));
+        _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_or_si128(c, alpha));
+        _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_or_si128(d, alpha));
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(a, alpha));
+    }
+#elif defined(YSFX_GFX_HAVE_NEON)
+    const uint32x4_t alpha = vdupq_n_u32(0xFF000000u);
+    for (; i + 4 <= count; i += 4)
+        vst1q_u32(dst + i, vorrq_u32(vld1q_u32(src + i), alpha));
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = src[i] | 0xFF000000u;
+}
+
 void YsfxGraphicsView::Impl::BackgroundWork::processGfxMessage(GfxMessage &msg)
 {
     ysfx_t *fx = msg.m_fx.get();
@@ -882,7 +952,10 @@ void YsfxGraphicsView::Impl::BackgroundWork::processGfxMessage(GfxMessage &msg)
 
     ///
     GfxTarget *target = msg.m_target.get();
-    bool mustRepaint;
+    bool fullRepaint = msg.m_dirty;
+    const uint32_t maxDirtyRects = 16;
+    ysfx_gfx_rect_t dirtyRects[maxDirtyRects];
+    uint32_t dirtyCount = 0;
 
     {
         juce::Image::BitmapData bdata{target->m_renderBitmap, juce::Image::BitmapData::readWrite};
@@ -898,50 +971,71 @@ void YsfxGraphicsView::Impl::BackgroundWork::processGfxMessage(GfxMessage &msg)
         gc.set_cursor = &setYsfxCursor;
         gc.get_drop_file = &getYsfxDropFile;
         ysfx_gfx_setup(fx, &gc);
-
-        // multiple @gfx cannot run concurrently on different threads (issue 44)
-        // FIXME: this workaround affects performance, actually fix this properly
-        static std::mutex globalGfxRunMutex;
-        std::lock_guard<std::mutex> gfxRunLock{globalGfxRunMutex};
-
-        mustRepaint = ysfx_gfx_run(fx) || msg.m_dirty;
+        if (ysfx_gfx_run(fx)) {
+            dirtyCount = ysfx_gfx_get_dirty_rects(fx, dirtyRects, maxDirtyRects);
+            fullRepaint = fullRepaint || dirtyCount > maxDirtyRects;
+        }
     }
 
     ///
-    std::lock_guard<std::mutex> lock{msg.m_asyncRepainter->m_mutex};
+    AsyncRepainter &repainter = *msg.m_asyncRepainter;
+    const juce::Image &imgsrc = target->m_renderBitmap;
+    const juce::Rectangle<int> bounds = imgsrc.getBounds();
+
+    // only the areas which @gfx has drawn differ from the previous frame
+    juce::RectangleList<int> region;
+    if (fullRepaint)
+        region.add(bounds);
+    else {
+        for (uint32_t i = 0; i < dirtyCount; ++i)
+            region.add(juce::Rectangle<int>{dirtyRects[i].x, dirtyRects[i].y, dirtyRects[i].w, dirtyRects[i].h});
+        region.clipTo(bounds);
+    }
 
-    if (!mustRepaint)
-        msg.m_asyncRepainter->m_hasBitmapChanged = false;
-    else
+    if (!region.isEmpty())
     {
-        juce::Image &imgsrc = target->m_renderBitmap;
-        juce::Image &imgdst = msg.m_asyncRepainter->m_bitmap;
-
-        int w = imgsrc.getWidth();
-        int h = imgsrc.getHeight();
-
-        if (w != imgdst.getWidth() || h != imgdst.getHeight())
-            imgdst = juce::Image{juce::Image::ARGB, w, h, false, juce::SoftwareImageType{}};
-
-        juce::Image::BitmapData src{imgsrc, juce::Image::BitmapData::readOnly};
-        juce::Image::BitmapData dst{imgdst, juce::Image::BitmapData::writeOnly};
+        const int back = repainter.m_back;
+        juce::Image &imgdst = repainter.m_bitmaps[back];
+
+        // the back bitmap also misses the frames published since it was filled
+        juce::RectangleList<int> copyRegion;
+        if (imgdst.getBounds() != bounds) {
+            imgdst = juce::Image{juce::Image::ARGB, bounds.getWidth(), bounds.getHeight(), false, juce::SoftwareImageType{}};
+            copyRegion.add(bounds);
+        }
+        else {
+            copyRegion = repainter.m_stale[back];
+            copyRegion.add(region);
+        }
 
-        // Set alpha channel to 255 explicitly.
-        for (int row = 0; row < h; ++row)
         {
-            juce::uint8* from = src.getLinePointer(row);
-            juce::uint8* to = dst.getLinePointer(row);
-            for (int pix = 0; pix < w; ++pix)
-            {
-                juce::uint32 pixel = *reinterpret_cast<const juce::uint32*>(from);
-                *reinterpret_cast<juce::uint32*>(to) = pixel | 0xFF000000;
-
-                from += src.pixelStride;
-                to += src.pixelStride;
+            juce::Image::BitmapData src{imgsrc, juce::Image::BitmapData::readOnly};
+            juce::Image::BitmapData dst{imgdst, juce::Image::BitmapData::readWrite};
+            for (const juce::Rectangle<int> &area : copyRegion) {
+                for (int row = area.getY(); row < area.getBottom(); ++row) {
+                    copyOpaquePixels(
+                        reinterpret_cast<const juce::uint32 *>(src.getPixelPointer(area.getX(), row)),
+                        reinterpret_cast<juce::uint32 *>(dst.getPixelPointer(area.getX(), row)),
+                        area.getWidth());
+                }
             }
         }
 
-        msg.m_asyncRepainter->m_hasBitmapChanged = true;
+        repainter.m_stale[back].clear();
+        for (int i = 0; i < 3; ++i) {
+            if (i == back)
+                continue;
+            juce::RectangleList<int> &stale = repainter.m_stale[i];
+            stale.add(region);
+            // one bitmap may stay on display for long, keep its list short
+            if (stale.getNumRectangles() > 16)
+                stale = juce::RectangleList<int>{stale.getBounds()};
+        }
+
+        repainter.publishBack();
+
+        std::lock_guard<std::mutex> lock{repainter.m_dirtyMutex};
+        repainter.m_dirtyRegion.add(region);
     }
 
     msg.m_asyncRepainter->triggerAsyncUpdate();
@@ -1008,8 +1102,15 @@ void YsfxGraphicsView::Impl::endPopupMenu(int menuResult)
 void YsfxGraphicsView::Impl::handleAsyncUpdate(better::AsyncUpdater *updater)
 {
     if (updater == m_asyncRepainter.get()) {
-        if (m_asyncRepainter->m_hasBitmapChanged)
-            m_self->repaint();
+        juce::RectangleList<int> region;
+        {
+            std::lock_guard<std::mutex> lock{m_asyncRepainter->m_dirtyMutex};
+            region.swapWith(m_asyncRepainter->m_dirtyRegion);
+        }
+        // the bitmap is drawn scaled, see `paint`
+        auto trafo = juce::AffineTransform::scale(m_self->m_outputScalingFactor.load() / m_self->m_pixelFactor.load());
+        for (const juce::Rectangle<int> &area : region)
+            m_self->repaint(area.toFloat().transformedBy(trafo).getSmallestIntegerContainer().expanded(1));
         m_numWaitedRepaints -= 1;
     }
     else if (updater == m_asyncMouseCursor.get()) {
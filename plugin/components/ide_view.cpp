@@ -220,22 +220,19 @@ void YsfxIDEView::Impl::buildVariableList()
     m_vars.clear();
     m_vars.ensureStorageAllocated(256);
 
-    ysfx_enum_vars(fx, +[](const char *name, ysfx_real *var, void *userdata) -> int {
+    ysfx_search_vars(fx, searchString.toRawUTF8(), ysfx_var_search_substring, +[](const char *name, ysfx_real *var, void *userdata) -> int {
         Impl &impl = *(Impl *)userdata;
         Impl::VariableUI ui;
         ui.m_var = var;
         ui.m_name = juce::CharPointer_UTF8{name};
-
-        if (impl.searchString.isEmpty() || ui.m_name.containsIgnoreCase(impl.searchString)) {
-            ui.m_lblName.reset(new juce::Label(juce::String{}, ui.m_name));
-            ui.m_lblName->setTooltip(ui.m_name);
-            ui.m_lblName->setMinimumHorizontalScale(1.0f);
-            impl.m_nameColumn->addAndMakeVisible(*ui.m_lblName);
-            ui.m_lblValue.reset(new juce::Label(juce::String{}, "0"));
-            ui.m_lblValue->setText(juce::String(*ui.m_var), juce::dontSendNotification);
-            impl.m_valueColumn->addAndMakeVisible(*ui.m_lblValue);
-            impl.m_vars.add(std::move(ui));
-        }
+        ui.m_lblName.reset(new juce::Label(juce::String{}, ui.m_name));
+        ui.m_lblName->setTooltip(ui.m_name);
+        ui.m_lblName->setMinimumHorizontalScale(1.0f);
+        impl.m_nameColumn->addAndMakeVisible(*ui.m_lblName);
+        ui.m_lblValue.reset(new juce::Label(juce::String{}, "0"));
+        ui.m_lblValue->setText(juce::String(*ui.m_var), juce::dontSendNotification);
+        impl.m_valueColumn->addAndMakeVisible(*ui.m_lblValue);
+        impl.m_vars.add(std::move(ui));
         return 1;
     }, this);
 
@@ -21,6 +21,7 @@
 #include "info.h"
 #include "utility/audio_processor_suspender.h"
 #include "utility/rt_semaphore.h"
+#include "utility/undo_history.h"
 #include "utility/sync_bitset.hpp"
 #include "ysfx.h"
 #include "bank_io.h"
@@ -29,7 +30,6 @@
 #include <mutex>
 #include <condition_variable>
 #include <cmath>
-#include <deque>
 #include <algorithm>
 
 struct YsfxProcessor::Impl : public juce::AudioProcessorListener {
@@ -43,6 +43,7 @@ struct YsfxProcessor::Impl : public juce::AudioProcessorListener {
     ysfx_bank_shared m_bank{nullptr};
 
     int m_maxUndoStack{64};
+    enum { midiBatchSize = 256 };
     double m_sample_rate{44100.0};
     uint32_t m_block_size{256};
 
@@ -99,8 +100,10 @@ struct YsfxProcessor::Impl : public juce::AudioProcessorListener {
     
     int64_t lastTransportPosition{0};
 
-    std::deque<ysfx_state_u> m_undoStack;
+    UndoHistory m_undoStack;
     int m_undoPosition{-1};
+    // the state generation of the effect when it was last saved for undo
+    uint64_t m_undoGeneration{~(uint64_t)0};
     bool m_hasUndo{false};
     bool m_hasRedo{false};
 
@@ -769,23 +772,37 @@ void YsfxProcessor::Impl::processMidiInput(juce::MidiBuffer &midi)
 {
     ysfx_t *fx = m_fx.get();
 
+    // transfer in fixed-size batches, to avoid allocating on the audio thread
+    ysfx_midi_event_t events[midiBatchSize];
+    uint32_t count = 0;
+
     for (juce::MidiMessageMetadata md : midi) {
-        ysfx_midi_event_t event{};
+        ysfx_midi_event_t &event = events[count++];
+        event.bus = 0;
         event.offset = (uint32_t)md.samplePosition;
         event.size = (uint32_t)md.numBytes;
         event.data = md.data;
-        ysfx_send_midi(fx, &event);
+        if (count == midiBatchSize) {
+            ysfx_send_midi_batch(fx, events, count);
+            count = 0;
+        }
     }
+
+    if (count > 0)
+        ysfx_send_midi_batch(fx, events, count);
 }
 
 void YsfxProcessor::Impl::processMidiOutput(juce::MidiBuffer &midi)
 {
     midi.clear();
 
-    ysfx_midi_event_t event;
     ysfx_t *fx = m_fx.get();
-    while (ysfx_receive_midi(fx, &event))
-        midi.addEvent(event.data, (int)event.size, (int)event.offset);
+    ysfx_midi_event_t events[midiBatchSize];
+    uint32_t count;
+    while ((count = ysfx_receive_midi_batch(fx, events, midiBatchSize)) > 0) {
+        for (uint32_t i = 0; i < count; ++i)
+            midi.addEvent(events[i].data, (int)events[i].size, (int)events[i].offset);
+    }
 }
 
 void YsfxProcessor::Impl::processSliderChanges()
@@ -1057,34 +1074,38 @@ void YsfxProcessor::Impl::pushUndoState()
 {
     if (!m_currentPresetInfo) return;
 
+    // Nothing has changed since the last save, skip suspending the audio
+    ysfx_t *fx = m_fx.get();
+    uint64_t generation = ysfx_get_state_generation(fx);
+    if (generation == m_undoGeneration) return;
+
     ysfx_state_t* state;
     {
         AudioProcessorSuspender sus(*m_self);
         sus.lockCallbacks();
-        ysfx_t *fx = m_fx.get();
         state = ysfx_save_state(fx);
     }
+    m_undoGeneration = generation;
 
     if (!m_currentPresetInfo) return;
 
-    // Verify that we don't already have this exact state
-    if ((m_undoPosition < m_undoStack.size()) && (m_undoPosition >= 0) && ysfx_is_state_equal(state, m_undoStack[m_undoPosition].get())) {
-        ysfx_state_free(state);
-        return;
-    }
-
     ysfx_state_u preset;
     preset.reset(state);
 
+    // Verify that we don't already have this exact state
+    uint64_t hash = UndoHistory::hashData(*preset);
+    if ((m_undoPosition < m_undoStack.size()) && (m_undoPosition >= 0) && m_undoStack.isEqual(static_cast<size_t>(m_undoPosition), *preset, hash))
+        return;
+
     // We add a new undo state -> Invalidate everything after our current position
     auto offset = std::min<int>(static_cast<int>(m_undoStack.size()), std::max<int>(1, m_undoPosition + 1));
-    m_undoStack.erase(m_undoStack.begin() + offset, m_undoStack.end());
+    m_undoStack.truncate(static_cast<size_t>(offset));
 
-    m_undoStack.emplace_back(std::move(preset));
+    m_undoStack.pushBack(*preset, hash);
     m_undoPosition = static_cast<int>(m_undoStack.size()) - 1;
 
     if (m_undoStack.size() > m_maxUndoStack) {
-        m_undoStack.pop_front();
+        m_undoStack.popFront();
         m_undoPosition -= 1;
     }
 
@@ -1093,14 +1114,22 @@ void YsfxProcessor::Impl::pushUndoState()
 
 void YsfxProcessor::Impl::popUndoState()
 {
-    AudioProcessorSuspender sus{*m_self};
-    sus.lockCallbacks();
-
     m_undoPosition = std::max<int>(-1, m_undoPosition - 1);
     if (m_undoPosition < 0) return;  // Nothing to undo
 
+    // Rebuild the state before suspending the audio
+    ysfx_state_u state = m_undoStack.get(static_cast<size_t>(m_undoPosition));
+    if (!state) {
+        // The history is corrupt, refuse to undo
+        m_undoPosition += 1;
+        return;
+    }
+
+    AudioProcessorSuspender sus{*m_self};
+    sus.lockCallbacks();
+
     ysfx_t *fx = m_fx.get();
-    ysfx_load_serialized_state(fx, m_undoStack[static_cast<size_t>(m_undoPosition)].get());
+    ysfx_load_serialized_state(fx, state.get());
     updateUndoState();
 
     m_background->wakeUp();
@@ -1108,14 +1137,22 @@ void YsfxProcessor::Impl::popUndoState()
 
 void YsfxProcessor::Impl::redoState()
 {
+    if ((m_undoPosition + 1) >= static_cast<int>(m_undoStack.size())) return;  // Nothing to redo
+    m_undoPosition += 1;
+
+    // Rebuild the state before suspending the audio
+    ysfx_state_u state = m_undoStack.get(static_cast<size_t>(m_undoPosition));
+    if (!state) {
+        // The history is corrupt, refuse to redo
+        m_undoPosition -= 1;
+        return;
+    }
+
     AudioProcessorSuspender sus{*m_self};
     sus.lockCallbacks();
 
-    if ((m_undoPosition + 1) >= static_cast<int>(m_undoStack.size())) return;  // Nothing to redo
-    m_undoPosition += 1;
-    
     ysfx_t *fx = m_fx.get();
-    ysfx_load_serialized_state(fx, m_undoStack[static_cast<size_t>(m_undoPosition)].get());
+    ysfx_load_serialized_state(fx, state.get());
     updateUndoState();
 
     m_background->wakeUp();
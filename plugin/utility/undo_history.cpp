@@ -0,0 +1,352 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "undo_history.h"
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+static uint64_t hashBytes(const uint8_t *data, size_t size)
+{
+    uint64_t h = 0x9e3779b97f4a7c15u ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdu;
+        h ^= h >> 32;
+    }
+    uint64_t word = 0;
+    memcpy(&word, data + i, size - i);
+    h = (h ^ word) * 0xc4ceb9fe1a85ec53u;
+    h ^= h >> 29;
+    return h;
+}
+
+//==============================================================================
+void UndoHistory::clear()
+{
+    m_entries.clear();
+    m_cachedIndex = ~(size_t)0;
+    m_cachedData.clear();
+}
+
+uint64_t UndoHistory::hashData(const ysfx_state_t &state)
+{
+    return hashBytes(state.data, state.data_size);
+}
+
+bool UndoHistory::isEqual(size_t index, const ysfx_state_t &state, uint64_t hash) const
+{
+    const Entry &entry = m_entries[index];
+
+    if (entry.sliders.size() != state.slider_count ||
+        memcmp(entry.sliders.data(), state.sliders, state.slider_count * sizeof(ysfx_state_slider_t)) != 0)
+        return false;
+
+    return entry.dataSize == state.data_size && entry.hash == hash;
+}
+
+ysfx_state_u UndoHistory::get(size_t index) const
+{
+    const Entry &entry = m_entries[index];
+    const std::vector<uint8_t> *rebuilt = rebuildData(index);
+    if (!rebuilt)
+        return nullptr;
+    const std::vector<uint8_t> &data = *rebuilt;
+
+    ysfx_state_u state{new ysfx_state_t{}};
+    state->slider_count = (uint32_t)entry.sliders.size();
+    state->sliders = new ysfx_state_slider_t[entry.sliders.size()];
+    memcpy(state->sliders, entry.sliders.data(), entry.sliders.size() * sizeof(ysfx_state_slider_t));
+    state->data_size = data.size();
+    state->data = new uint8_t[data.size()];
+    memcpy(state->data, data.data(), data.size());
+    return state;
+}
+
+void UndoHistory::pushBack(const ysfx_state_t &state, uint64_t hash)
+{
+    Entry entry;
+    entry.sliders.assign(state.sliders, state.sliders + state.slider_count);
+    entry.hash = hash;
+    entry.dataSize = state.data_size;
+
+    size_t chain = 0;
+    for (size_t i = m_entries.size(); i-- > 0 && !m_entries[i].full; )
+        ++chain;
+
+    const std::vector<uint8_t> *base = nullptr;
+    if (!m_entries.empty() && chain + 1 < maxDeltaChain)
+        base = rebuildData(m_entries.size() - 1);
+
+    if (base) {
+        std::vector<uint8_t> delta = encodeBinaryDelta(base->data(), base->size(), state.data, state.data_size);
+        // a delta which saves little is not worth rebuilding for
+        if (delta.size() < state.data_size / 2)
+            entry.payload = std::move(delta);
+        else
+            entry.full = true;
+    }
+    else
+        entry.full = true;
+
+    if (entry.full)
+        entry.payload.assign(state.data, state.data + state.data_size);
+
+    m_entries.push_back(std::move(entry));
+
+    // this state is the base of the next delta
+    m_cachedIndex = m_entries.size() - 1;
+    m_cachedData.assign(state.data, state.data + state.data_size);
+}
+
+void UndoHistory::popFront()
+{
+    if (m_entries.empty())
+        return;
+
+    // the next entry becomes the first, make it a full copy; if it cannot be
+    // rebuilt, it stays a delta which fails to rebuild from now on
+    if (m_entries.size() > 1 && !m_entries[1].full) {
+        if (const std::vector<uint8_t> *data = rebuildData(1)) {
+            m_entries[1].payload = *data;
+            m_entries[1].full = true;
+        }
+    }
+
+    m_entries.pop_front();
+
+    if (m_cachedIndex == 0)
+        m_cachedIndex = ~(size_t)0;
+    else if (m_cachedIndex != ~(size_t)0)
+        --m_cachedIndex;
+}
+
+void UndoHistory::truncate(size_t count)
+{
+    while (m_entries.size() > count)
+        m_entries.pop_back();
+
+    if (m_cachedIndex != ~(size_t)0 && m_cachedIndex >= count)
+        m_cachedIndex = ~(size_t)0;
+}
+
+const std::vector<uint8_t> *UndoHistory::rebuildData(size_t index) const
+{
+    if (index == m_cachedIndex)
+        return &m_cachedData;
+
+    size_t start = index;
+    while (!m_entries[start].full) {
+        if (start == 0)
+            return nullptr;
+        --start;
+    }
+
+    // start from the cached state if it is on the way
+    std::vector<uint8_t> data;
+    size_t next;
+    if (m_cachedIndex != ~(size_t)0 && m_cachedIndex >= start && m_cachedIndex < index) {
+        data = std::move(m_cachedData);
+        next = m_cachedIndex + 1;
+    }
+    else {
+        data = m_entries[start].payload;
+        next = start + 1;
+    }
+
+    // the cached data may have been taken, the cache is set again on success
+    m_cachedIndex = ~(size_t)0;
+
+    std::vector<uint8_t> target;
+    for (; next <= index; ++next) {
+        const std::vector<uint8_t> &delta = m_entries[next].payload;
+        if (!applyBinaryDelta(data.data(), data.size(), delta.data(), delta.size(), target))
+            return nullptr;
+        data.swap(target);
+    }
+
+    m_cachedIndex = index;
+    m_cachedData = std::move(data);
+    return &m_cachedData;
+}
+
+//==============================================================================
+// The delta is the size of the target, followed by a list of operations which
+// produce it. Each is a variable-length integer `length << 1 | kind`, where the
+// kind 0 is a literal followed by its bytes, and the kind 1 is a copy followed
+// by the offset in the base.
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static bool getVarint(const uint8_t *&cur, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; cur != end && shift < 64; shift += 7) {
+        uint8_t byte = *cur++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+namespace {
+
+enum { deltaBlockSize = 64 };
+
+// the weak checksum of rsync, which rolls forward one byte at a time
+struct RollingHash {
+    uint32_t a = 0;
+    uint32_t b = 0;
+
+    void reset(const uint8_t *data)
+    {
+        a = b = 0;
+        for (uint32_t i = 0; i < deltaBlockSize; ++i) {
+            a += data[i];
+            b += (deltaBlockSize - i) * data[i];
+        }
+    }
+    void roll(uint8_t out, uint8_t in)
+    {
+        a += in - out;
+        b += a - deltaBlockSize * out;
+    }
+    uint32_t value() const { return (b << 16) | (a & 0xffff); }
+};
+
+} // namespace
+
+std::vector<uint8_t> encodeBinaryDelta(const uint8_t *base, size_t baseSize, const uint8_t *target, size_t targetSize)
+{
+    std::vector<uint8_t> delta;
+    putVarint(delta, targetSize);
+
+    size_t literalStart = 0;
+    auto flushLiteral = [&](size_t end) {
+        if (end > literalStart) {
+            putVarint(delta, (uint64_t)(end - literalStart) << 1);
+            delta.insert(delta.end(), target + literalStart, target + end);
+        }
+    };
+
+    if (baseSize >= deltaBlockSize && targetSize >= deltaBlockSize) {
+        // index the blocks of the base, the first one of a given hash wins
+        std::unordered_map<uint32_t, size_t> blocks;
+        blocks.reserve(baseSize / deltaBlockSize);
+        for (size_t offset = baseSize - baseSize % deltaBlockSize; offset > 0; ) {
+            offset -= deltaBlockSize;
+            RollingHash hash;
+            hash.reset(base + offset);
+            blocks[hash.value()] = offset;
+        }
+
+        // where the target is expected to continue in the base, on the
+        // assumption that edits are in place
+        size_t expect = ~(size_t)0;
+
+        RollingHash hash;
+        hash.reset(target);
+
+        size_t pos = 0;
+        while (pos + deltaBlockSize <= targetSize) {
+            size_t found = ~(size_t)0;
+
+            if (expect != ~(size_t)0) {
+                size_t guess = expect + (pos - literalStart);
+                if (guess + deltaBlockSize <= baseSize && base[guess] == target[pos] &&
+                    memcmp(base + guess, target + pos, deltaBlockSize) == 0)
+                    found = guess;
+            }
+            if (found == ~(size_t)0) {
+                auto it = blocks.find(hash.value());
+                if (it != blocks.end() && memcmp(base + it->second, target + pos, deltaBlockSize) == 0)
+                    found = it->second;
+            }
+
+            if (found == ~(size_t)0) {
+                if (pos + deltaBlockSize < targetSize)
+                    hash.roll(target[pos], target[pos + deltaBlockSize]);
+                ++pos;
+                continue;
+            }
+
+            // extend the match as far as it goes
+            size_t length = deltaBlockSize;
+            while (pos + length < targetSize && found + length < baseSize && target[pos + length] == base[found + length])
+                ++length;
+
+            flushLiteral(pos);
+            putVarint(delta, ((uint64_t)length << 1) | 1);
+            putVarint(delta, found);
+
+            pos += length;
+            literalStart = pos;
+            expect = found + length;
+            if (pos + deltaBlockSize <= targetSize)
+                hash.reset(target + pos);
+        }
+    }
+
+    flushLiteral(targetSize);
+    return delta;
+}
+
+bool applyBinaryDelta(const uint8_t *base, size_t baseSize, const uint8_t *delta, size_t deltaSize, std::vector<uint8_t> &target)
+{
+    const uint8_t *cur = delta;
+    const uint8_t *end = delta + deltaSize;
+
+    uint64_t targetSize;
+    if (!getVarint(cur, end, targetSize))
+        return false;
+
+    target.clear();
+    // the size is not validated yet, so do not trust it beyond what a
+    // delta of this length could plausibly produce; copies may go further
+    target.reserve((size_t)std::min<uint64_t>(targetSize, (uint64_t)baseSize + deltaSize));
+
+    while (cur != end) {
+        uint64_t op;
+        if (!getVarint(cur, end, op))
+            return false;
+        uint64_t length = op >> 1;
+        if (op & 1) {
+            uint64_t offset;
+            if (!getVarint(cur, end, offset) || offset > baseSize || length > baseSize - offset)
+                return false;
+            target.insert(target.end(), base + offset, base + offset + length);
+        }
+        else {
+            if (length > (uint64_t)(end - cur))
+                return false;
+            target.insert(target.end(), cur, cur + length);
+            cur += length;
+        }
+    }
+
+    return target.size() == targetSize;
+}
@@ -0,0 +1,72 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A list of effect states which stores most of them as binary deltas
+//
+// Successive states of an effect tend to differ by a few values, so each one
+// is stored as the difference against its predecessor, computed by matching
+// blocks with a rolling hash. A full copy is kept at regular intervals, which
+// bounds the number of deltas to apply when rebuilding a state.
+class UndoHistory {
+public:
+    size_t size() const { return m_entries.size(); }
+    void clear();
+
+    // the hash of the serialized data, computed once for the calls below
+    static uint64_t hashData(const ysfx_state_t &state);
+
+    // whether the state is the same as the one at this index, by hash
+    bool isEqual(size_t index, const ysfx_state_t &state, uint64_t hash) const;
+    // rebuild the state at this index, or null if its data is corrupt
+    ysfx_state_u get(size_t index) const;
+
+    void pushBack(const ysfx_state_t &state, uint64_t hash);
+    void popFront();
+    // remove the entries from this index onwards
+    void truncate(size_t count);
+
+private:
+    struct Entry {
+        std::vector<ysfx_state_slider_t> sliders;
+        // the data if `full`, otherwise the delta against the previous entry
+        std::vector<uint8_t> payload;
+        bool full = false;
+        uint64_t hash = 0;
+        size_t dataSize = 0;
+    };
+
+    enum { maxDeltaChain = 16 };
+
+    const std::vector<uint8_t> *rebuildData(size_t index) const;
+
+    std::deque<Entry> m_entries;
+
+    // the last state which was rebuilt, it is usually the one diffed next
+    mutable size_t m_cachedIndex = ~(size_t)0;
+    mutable std::vector<uint8_t> m_cachedData;
+};
+
+// the difference of `target` against `base`, and the opposite operation
+std::vector<uint8_t> encodeBinaryDelta(const uint8_t *base, size_t baseSize, const uint8_t *target, size_t targetSize);
+bool applyBinaryDelta(const uint8_t *base, size_t baseSize, const uint8_t *delta, size_t deltaSize, std::vector<uint8_t> &target);
@@ -0,0 +1,147 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace ysfx {
+
+//------------------------------------------------------------------------------
+// alias_table: Immutable map of ASCII case-insensitive names to integers
+//
+// An open-addressed table with linear probing, at most half full, whose slots
+// refer to the folded names stored one after the other in a single string.
+// A lookup hashes the name as it goes, folding case, then compares against
+// the slots of the same hash; it never allocates.
+
+class alias_table {
+public:
+    // the first of duplicate names is kept
+    void build(const std::vector<std::pair<std::string, uint32_t>> &entries);
+    void clear() { *this = alias_table{}; }
+    bool empty() const { return m_count == 0; }
+    size_t size() const { return m_count; }
+
+    bool find(const char *name, uint32_t &value) const;
+
+private:
+    static char fold(char c) { return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c; }
+    static uint32_t hash(const char *name);
+    bool equals_folded(const char *name, uint32_t offset, uint32_t length) const;
+
+private:
+    enum : uint32_t { empty_slot = ~(uint32_t)0 };
+    struct slot {
+        uint32_t hash = 0;
+        // the position of the name in the storage, or empty_slot
+        uint32_t name = empty_slot;
+        uint32_t length = 0;
+        uint32_t value = 0;
+    };
+    std::vector<slot> m_slots;
+    std::string m_names;
+    uint32_t m_mask = 0;
+    size_t m_count = 0;
+};
+
+inline uint32_t alias_table::hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; ++name) {
+        h ^= (unsigned char)fold(*name);
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+inline bool alias_table::equals_folded(const char *name, uint32_t offset, uint32_t length) const
+{
+    const char *folded = m_names.data() + offset;
+    uint32_t i = 0;
+    for (; i < length && name[i]; ++i) {
+        if (fold(name[i]) != folded[i])
+            return false;
+    }
+    return i == length && !name[i];
+}
+
+inline void alias_table::build(const std::vector<std::pair<std::string, uint32_t>> &entries)
+{
+    clear();
+
+    if (entries.empty())
+        return;
+
+    // a load factor of 1/2 at most
+    uint32_t size = 1;
+    while (size < 2 * entries.size())
+        size *= 2;
+    m_slots.resize(size);
+    m_mask = size - 1;
+
+    size_t total_length = 0;
+    for (const auto &ent : entries)
+        total_length += ent.first.size();
+    m_names.reserve(total_length);
+
+    for (const auto &ent : entries) {
+        const char *name = ent.first.c_str();
+        uint32_t length = (uint32_t)ent.first.size();
+        uint32_t h = hash(name);
+
+        uint32_t index = h & m_mask;
+        bool duplicate = false;
+        for (; m_slots[index].name != empty_slot && !duplicate; index = (index + 1) & m_mask) {
+            const slot &other = m_slots[index];
+            duplicate = other.hash == h && equals_folded(name, other.name, other.length);
+        }
+        if (duplicate)
+            continue;
+
+        slot &s = m_slots[index];
+        s.hash = h;
+        s.name = (uint32_t)m_names.size();
+        s.length = length;
+        s.value = ent.second;
+        for (char c : ent.first)
+            m_names.push_back(fold(c));
+        ++m_count;
+    }
+}
+
+inline bool alias_table::find(const char *name, uint32_t &value) const
+{
+    if (m_count == 0)
+        return false;
+    uint32_t h = hash(name);
+    for (uint32_t index = h & m_mask; m_slots[index].name != empty_slot; index = (index + 1) & m_mask) {
+        const slot &s = m_slots[index];
+        if (s.hash == h && equals_folded(name, s.name, s.length)) {
+            value = s.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace ysfx
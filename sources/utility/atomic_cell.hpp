@@ -0,0 +1,94 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace ysfx {
+
+//------------------------------------------------------------------------------
+// atomic_cell: Lock-free operations on a plain `double` in memory
+//
+// The VM memory is not made of `std::atomic`, so these operate on the bit
+// pattern of the value in place. They require an 8-byte aligned address,
+// check with `atomic_cell_is_lock_free` before use.
+
+static_assert(sizeof(double) == sizeof(uint64_t), "unexpected size of double");
+
+inline bool atomic_cell_is_lock_free(const double *cell)
+{
+    return ((uintptr_t)cell & (sizeof(uint64_t) - 1)) == 0;
+}
+
+inline double atomic_cell_bits_to_value(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint64_t atomic_cell_value_to_bits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t atomic_cell_load_bits(const double *cell)
+{
+#if defined(_MSC_VER)
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)cell, 0, 0);
+#else
+    return __atomic_load_n((const uint64_t *)cell, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// on failure, `expected` is updated with the current bits
+inline bool atomic_cell_compare_exchange_bits(double *cell, uint64_t &expected, uint64_t desired)
+{
+#if defined(_MSC_VER)
+    uint64_t previous = (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)cell, (__int64)desired, (__int64)expected);
+    bool success = previous == expected;
+    expected = previous;
+    return success;
+#else
+    return __atomic_compare_exchange_n((uint64_t *)cell, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline double atomic_cell_load(const double *cell)
+{
+    return atomic_cell_bits_to_value(atomic_cell_load_bits(cell));
+}
+
+inline double atomic_cell_exchange(double *cell, double value)
+{
+    uint64_t desired = atomic_cell_value_to_bits(value);
+#if defined(_MSC_VER)
+    uint64_t expected = atomic_cell_load_bits(cell);
+    while (!atomic_cell_compare_exchange_bits(cell, expected, desired));
+    return atomic_cell_bits_to_value(expected);
+#else
+    return atomic_cell_bits_to_value(__atomic_exchange_n((uint64_t *)cell, desired, __ATOMIC_SEQ_CST));
+#endif
+}
+
+} // namespace ysfx
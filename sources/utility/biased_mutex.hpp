@@ -0,0 +1,82 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace ysfx {
+
+//------------------------------------------------------------------------------
+// biased_mutex: A mutex which is biased towards a single preferred thread
+//
+// The preferred thread acquires with `lock_fast`, which is a pair of atomic
+// operations and does not touch the underlying mutex unless another thread
+// currently holds the lock. Other threads use `lock`, and pay for it: they take
+// the mutex, then wait for the preferred thread to leave.
+//
+// `lock_fast` must never be called by 2 threads at once. This fits the DSP
+// thread of an effect, which is the only one to run the audio processing.
+
+template <class Mutex>
+class basic_biased_mutex {
+public:
+    void lock_fast()
+    {
+        m_fast_busy.store(true, std::memory_order_seq_cst);
+        if (!m_slow_busy.load(std::memory_order_seq_cst)) {
+            m_fast_via_mutex = false;
+            return;
+        }
+
+        // contended: step back and queue behind the current owner
+        m_fast_busy.store(false, std::memory_order_seq_cst);
+        m_mutex.lock();
+        m_fast_via_mutex = true;
+    }
+
+    void unlock_fast()
+    {
+        if (m_fast_via_mutex)
+            m_mutex.unlock();
+        else
+            m_fast_busy.store(false, std::memory_order_release);
+    }
+
+    void lock()
+    {
+        m_mutex.lock();
+        m_slow_busy.store(true, std::memory_order_seq_cst);
+        while (m_fast_busy.load(std::memory_order_seq_cst))
+            std::this_thread::yield();
+    }
+
+    void unlock()
+    {
+        m_slow_busy.store(false, std::memory_order_release);
+        m_mutex.unlock();
+    }
+
+private:
+    Mutex m_mutex;
+    std::atomic<bool> m_fast_busy{false};
+    std::atomic<bool> m_slow_busy{false};
+    bool m_fast_via_mutex = false;
+};
+
+} // namespace ysfx
@@ -43,10 +43,6 @@
 static_assert(std::is_same<EEL_F, ysfx_real>::value,
               "ysfx_real is incorrectly defined");
 
-enum {
-    ysfx_max_file_handles = 64, // change if it needs more
-};
-
 //------------------------------------------------------------------------------
 static thread_local ysfx_thread_id_t ysfx_thread_id;
 
@@ -129,13 +125,9 @@ ysfx_t *ysfx_new(ysfx_config_t *config)
     auto var_resolver = [](void *userdata, const char *name) -> EEL_F * {
         ysfx_t *fx = (ysfx_t *)userdata;
 
-        /* Not very efficient */
-        std::string lower_name{name};
-        std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ysfx::ascii_tolower);
-
-        auto it = fx->source.slider_alias.find(lower_name);
-        if (it != fx->source.slider_alias.end())
-            return fx->var.slider[it->second];
+        uint32_t index;
+        if (fx->source.slider_alias.find(name, index))
+            return fx->var.slider[index];
         return nullptr;
     };
     NSEEL_VM_set_var_resolver(vm, var_resolver, fx.get());
@@ -197,8 +189,15 @@ ysfx_t *ysfx_new(ysfx_config_t *config)
     fx->midi.out.reset(new ysfx_midi_buffer_t);
     ysfx_set_midi_capacity(fx.get(), 1024, true);
 
-    fx->file.list.reserve(16);
-    fx->file.list.emplace_back(new ysfx_serializer_t(fx->vm.get()));
+    // handle 0 is the serializer, and stays open
+    uint32_t file_capacity = fx->config->max_file_handles;
+    fx->file.slots.reset(new ysfx_t::file_slot[file_capacity]);
+    fx->file.capacity = file_capacity;
+    while ((1u << fx->file.index_bits) < file_capacity)
+        ++fx->file.index_bits;
+    fx->file.free.reserve(file_capacity);
+    fx->file.slots[0].file.reset(new ysfx_serializer_t(fx->vm.get()));
+    fx->file.open_count.store(1, std::memory_order_relaxed);
 
     return fx.release();
 }
@@ -302,16 +301,14 @@ bool ysfx_load_file(ysfx_t *fx, const char *filepath, uint32_t loadopts)
         }
 
         // register variables aliased to sliders
+        std::vector<std::pair<std::string, uint32_t>> aliases;
         for (uint32_t i = 0; i < ysfx_max_sliders; ++i) {
             if (main->header.sliders[i].exists) {
                 if (!main->header.sliders[i].var.empty())
-                {
-                    std::string data = main->header.sliders[i].var;
-                    std::transform(data.begin(), data.end(), data.begin(), ysfx::ascii_tolower);
-                    fx->source.slider_alias.insert({data, i});
-                }
+                    aliases.emplace_back(main->header.sliders[i].var, i);
             }
         }
+        fx->source.slider_alias.build(aliases);
 
         fx->source.main = std::move(main);
         fx->source.main_file_path.assign(filepath);
@@ -424,12 +421,67 @@ bool ysfx_load_file(ysfx_t *fx, const char *filepath, uint32_t loadopts)
     for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
         *fx->var.slider[i] = fx->source.main->header.sliders[i].def;
 
+    //--------------------------------------------------------------------------
+    // start decoding the audio files selected by default
+    //   the code can open audio files of its own, which are decoded in the
+    //   background as well, so that it does not decode on the audio thread
+
+    fx->source.prefetcher = ysfx_audio_prefetcher_acquire();
+    ysfx_fill_slider_files(fx);
+    ysfx_prefetch_all_slider_files(fx);
+
     //--------------------------------------------------------------------------
 
     fail_guard.disarm();
     return true;
 }
 
+// whether the code of @serialize reads memory only with file_mem, such that
+// the data it saves is all derived from what the state hash covers
+//   this is decided on the text, conservatively: any memory access, string,
+//   or call of a function which is not known to be free of memory reads
+//   makes it untraceable, even inside of a comment
+static bool ysfx_serialize_is_traceable(const std::string &text)
+{
+    static const char *const known_functions[] = {
+        "file_var", "file_mem", "file_avail", "loop", "while",
+        "sin", "cos", "tan", "asin", "acos", "atan", "atan2", "sqr", "sqrt",
+        "pow", "exp", "log", "log10", "abs", "min", "max", "sign", "floor",
+        "ceil", "invsqrt",
+    };
+
+    auto is_name_char = [](char c) -> bool {
+        return ysfx::ascii_isalpha(c) || (c >= '0' && c <= '9') || c == '_' || c == '.';
+    };
+
+    for (size_t i = 0, n = text.size(); i < n; ) {
+        char c = text[i];
+        if (c == '[' || c == '#' || c == '"')
+            return false;
+        if (!is_name_char(c)) {
+            ++i;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < n && is_name_char(text[i]))
+            ++i;
+        size_t end = i;
+        while (i < n && ysfx::ascii_isspace(text[i]))
+            ++i;
+        if (i < n && text[i] == '(') {
+            std::string_view name{&text[start], end - start};
+            bool known = false;
+            for (const char *function : known_functions)
+                known = known || name == function;
+            if (!known)
+                return false;
+        }
+    }
+
+    return true;
+}
+
 bool ysfx_compile(ysfx_t *fx, uint32_t compileopts)
 {
     ysfx_unload_code(fx);
@@ -534,57 +586,100 @@ bool ysfx_compile(ysfx_t *fx, uint32_t compileopts)
 
     ///
     ysfx_eel_string_context_update_named_vars(fx->string_ctx.get(), vm);
+    ysfx_build_var_index(fx);
+    ysfx_build_reset_plan(fx);
+
+    // without @serialize, the sliders are all the state
+    {
+        std::lock_guard<ysfx::mutex> lock{fx->state.mutex};
+        fx->state.complete = !fx->has_serialize;
+        fx->state.traceable = !serialize || ysfx_serialize_is_traceable(serialize->text);
+    }
 
     fail_guard.disarm();
     return true;
 }
 
-void ysfx_reinitialize_vars(ysfx_t *fx)
+static size_t ysfx_get_var_count(NSEEL_VMCTX vm)
+{
+    compileContext *ctx = (compileContext *)vm;
+    return (size_t)EEL_GROWBUF_GET_SIZE(&ctx->varNameList);
+}
+
+// Variables which keep their value on re-@init, in addition to the built-ins
+static const char *const ysfx_persistent_var_names[] = {
+    "gfx_r", "gfx_g", "gfx_b", "gfx_a", "gfx_a2", "gfx_w", "gfx_h", "gfx_x", "gfx_y",
+    "gfx_mode", "gfx_dest", "gfx_clear", "gfx_texth", "gfx_ext_retina",
+    "mouse_x", "mouse_y", "mouse_cap", "mouse_wheel", "mouse_hwheel",
+};
+
+static bool ysfx_is_reset_var(const ysfx_s::reset_plan &plan, const char *name, EEL_F *var)
+{
+    // If this is a plugin built-in, we shouldn't reset it.
+    if (std::binary_search(plan.builtins.begin(), plan.builtins.end(), var))
+        return false;
+    for (const char *persistent : ysfx_persistent_var_names) {
+        if (!strcmp(name, persistent))
+            return false;
+    }
+    return true;
+}
+
+void ysfx_build_reset_plan(ysfx_t *fx)
 {
+    struct plan_data {
+        ysfx_s::reset_plan *plan = nullptr;
+        std::vector<ysfx_real *> vars;
+    };
+
+    ysfx_s::reset_plan &plan = fx->code.reset;
+    plan = {};
+    plan.builtins.assign(fx->built_ins.vars, fx->built_ins.vars + fx->built_ins.count);
+    std::sort(plan.builtins.begin(), plan.builtins.end());
+
+    plan_data pd;
+    pd.plan = &plan;
+
     auto callback = [](const char *name, EEL_F *var, void *userdata) -> int {
-        ysfx_s::fixed_variables* built_ins = (ysfx_s::fixed_variables*) userdata;
+        plan_data *pd = (plan_data *)userdata;
+        if (ysfx_is_reset_var(*pd->plan, name, var))
+            pd->vars.push_back(var);
+        return 1;
+    };
+    NSEEL_VM_enumallvars(fx->vm.get(), +callback, &pd);
 
-        bool found = false;
-        for (int i=0; i < built_ins->count; i++) {
-            // If this is a plugin built-in, we shouldn't reset it.
-            if (var == built_ins->vars[i]) {
-                found = true;
-            }
-        }
+    // the VM allocates values in consecutive blocks, so variables mostly
+    // collapse into a handful of contiguous runs
+    std::sort(pd.vars.begin(), pd.vars.end());
 
-        if (
-            !(true
-                && strcmp(name, "gfx_r")
-                && strcmp(name, "gfx_g")
-                && strcmp(name, "gfx_b")
-                && strcmp(name, "gfx_a")
-                && strcmp(name, "gfx_a2")
-                && strcmp(name, "gfx_w")
-                && strcmp(name, "gfx_h")
-                && strcmp(name, "gfx_x")
-                && strcmp(name, "gfx_y")
-                && strcmp(name, "gfx_mode")
-                && strcmp(name, "gfx_dest")
-                && strcmp(name, "gfx_clear")
-                && strcmp(name, "gfx_texth")
-                && strcmp(name, "mouse_x")
-                && strcmp(name, "mouse_y")
-                && strcmp(name, "mouse_y")
-                && strcmp(name, "mouse_cap")
-                && strcmp(name, "mouse_wheel")
-                && strcmp(name, "mouse_hwheel")
-                && strcmp(name, "gfx_ext_retina")
-            )
-        ) {
-            found = true;
-        }
+    for (EEL_F *var : pd.vars) {
+        if (!plan.runs.empty() && plan.runs.back().start + plan.runs.back().count == var)
+            ++plan.runs.back().count;
+        else
+            plan.runs.push_back({var, 1});
+    }
+    plan.var_count = ysfx_get_var_count(fx->vm.get());
+}
+
+void ysfx_reinitialize_vars(ysfx_t *fx)
+{
+    const ysfx_s::reset_plan &plan = fx->code.reset;
+
+    if (plan.var_count == ysfx_get_var_count(fx->vm.get())) {
+        for (const ysfx_s::reset_plan::run &run : plan.runs)
+            std::fill_n(run.start, run.count, (EEL_F)0);
+        return;
+    }
 
-        if (!found) {
+    // variables were registered since the plan was made; this runs on the
+    // audio thread, so don't replan, but check every variable as it goes
+    auto callback = [](const char *name, EEL_F *var, void *userdata) -> int {
+        const ysfx_s::reset_plan *plan = (const ysfx_s::reset_plan *)userdata;
+        if (ysfx_is_reset_var(*plan, name, var))
             *var = 0;
-        }
         return 1;
     };
-    NSEEL_VM_enumallvars(fx->vm.get(), +callback, &fx->built_ins);
+    NSEEL_VM_enumallvars(fx->vm.get(), +callback, (void *)&plan);
 }
 
 bool ysfx_is_compiled(ysfx_t *fx)
@@ -616,11 +711,22 @@ void ysfx_unload_code(ysfx_t *fx)
     fx->must_compute_init = false;
     fx->must_compute_slider = false;
 
+    // the coverage of @serialize refers to the variables of the code, drop
+    // it before these are freed
+    {
+        std::lock_guard<ysfx::mutex> lock{fx->state.mutex};
+        fx->state.coverage = {};
+        fx->state.complete = false;
+        fx->state.traceable = false;
+    }
+
     NSEEL_VMCTX vm = fx->vm.get();
     NSEEL_code_compile_ex(vm, nullptr, 0, NSEEL_CODE_COMPILE_FLAG_COMMONFUNCS_RESET);
     NSEEL_VM_remove_unused_vars(vm);
     NSEEL_VM_remove_all_nonreg_vars(vm);
     NSEEL_VM_freeRAM(vm);
+
+    ysfx_touch_state(fx);
 }
 
 void ysfx_unload(ysfx_t *fx)
@@ -665,6 +771,68 @@ void ysfx_fill_file_enums(ysfx_t *fx)
     }
 }
 
+void ysfx_fill_slider_files(ysfx_t *fx)
+{
+    for (uint32_t i = 0; i < ysfx_max_sliders; ++i) {
+        ysfx_slider_t &slider = fx->source.main->header.sliders[i];
+        if (slider.path.empty())
+            continue;
+
+        std::vector<ysfx_audio_prefetch_t> &files = fx->source.slider_files[i];
+        files.resize(slider.enum_names.size());
+
+        // resolve the same way that `file_open` does, so the cache keys match
+        for (size_t j = 0; j < slider.enum_names.size(); ++j) {
+            std::string filepath;
+            if (!ysfx_find_data_file_part(fx, slider.path + '/' + slider.enum_names[j], false, true, filepath))
+                continue;
+
+            void *fmtobj = nullptr;
+            if (ysfx_detect_file_type(fx, filepath.c_str(), &fmtobj) != ysfx_file_type_audio)
+                continue;
+
+            files[j].fmt = *(ysfx_audio_format_t *)fmtobj;
+            files[j].path = std::make_shared<const std::string>(std::move(filepath));
+        }
+    }
+}
+
+void ysfx_prefetch_slider_files(ysfx_t *fx, uint32_t index, bool replace)
+{
+    if (!fx->source.prefetcher)
+        return;
+
+    const std::vector<ysfx_audio_prefetch_t> &files = fx->source.slider_files[index];
+    if (files.empty())
+        return;
+
+    // the selected file first, then its neighbours, which are the next ones
+    // to be selected when stepping through the list
+    int32_t value = ysfx_eel_round<int32_t>(*fx->var.slider[index]);
+    const int32_t order[] = {value, value + 1, value - 1};
+
+    ysfx_audio_prefetch_t requests[3];
+    uint32_t count = 0;
+    for (int32_t j : order) {
+        if (j >= 0 && (uint32_t)j < files.size() && files[(uint32_t)j].path)
+            requests[count++] = files[(uint32_t)j];
+    }
+
+    if (count > 0)
+        ysfx_audio_prefetch(fx->source.prefetcher.get(), requests, count, replace);
+}
+
+void ysfx_prefetch_all_slider_files(ysfx_t *fx)
+{
+    if (!fx->source.prefetcher)
+        return;
+
+    // supersede the older requests once, then queue every slider
+    ysfx_audio_prefetch(fx->source.prefetcher.get(), nullptr, 0, true);
+    for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
+        ysfx_prefetch_slider_files(fx, i, false);
+}
+
 void ysfx_fix_invalid_enums(ysfx_t *fx)
 {
     //NOTE: regardless of the range of enum sliders in source, it is <0,N-1,1>
@@ -1168,6 +1336,8 @@ void ysfx_slider_set_value(ysfx_t *fx, uint32_t index, ysfx_real value, bool not
     if (*fx->var.slider[index] != value) {
         *fx->var.slider[index] = value;
         fx->must_compute_slider = notify;
+        ysfx_prefetch_slider_files(fx, index);
+        ysfx_touch_state(fx);
     }
 }
 
@@ -1312,6 +1482,7 @@ void ysfx_init(ysfx_t *fx)
 
     fx->must_compute_init = false;
     fx->must_compute_slider = true;
+    ysfx_touch_state(fx);
 
 #if !defined(YSFX_NO_GFX)
     // do initializations on next @gfx, on the gfx thread
@@ -1422,6 +1593,16 @@ bool ysfx_receive_midi_from_bus(ysfx_t *fx, uint32_t bus, ysfx_midi_event_t *eve
     return ysfx_midi_get_next_from_bus(fx->midi.out.get(), 0, event);
 }
 
+uint32_t ysfx_send_midi_batch(ysfx_t *fx, const ysfx_midi_event_t *events, uint32_t count)
+{
+    return ysfx_midi_push_batch(fx->midi.in.get(), events, count);
+}
+
+uint32_t ysfx_receive_midi_batch(ysfx_t *fx, ysfx_midi_event_t *events, uint32_t count)
+{
+    return ysfx_midi_get_batch(fx->midi.out.get(), events, count);
+}
+
 uint32_t ysfx_current_midi_bus(ysfx_t *fx)
 {
     uint32_t bus = 0;
@@ -1580,62 +1761,170 @@ void ysfx_process_double(ysfx_t *fx, const double *const *ins, double *const *ou
 
 void ysfx_clear_files(ysfx_t *fx)
 {
-    std::lock_guard<ysfx::mutex> list_lock(fx->file.list_mutex);
+    std::lock_guard<ysfx::mutex> alloc_lock(fx->file.alloc_mutex);
 
     // delete all except the serializer
-    while (fx->file.list.size() > 1) {
-        ysfx_file_t *file = fx->file.list.back().get();
-        std::unique_ptr<ysfx::mutex> file_mutex;
-        std::unique_lock<ysfx::mutex> file_lock;
-        if (file) {
-            file_lock = std::unique_lock<ysfx::mutex>{*fx->file.list.back()->m_mutex};
-            file_mutex = std::move(fx->file.list.back()->m_mutex);
+    for (uint32_t index = 1; index < fx->file.top; ++index) {
+        ysfx_t::file_slot &slot = fx->file.slots[index];
+        std::lock_guard<ysfx::mutex> lock(slot.mutex);
+        if (slot.file) {
+            slot.file.reset();
+            ++slot.generation;
+            fx->file.open_count.fetch_sub(1, std::memory_order_relaxed);
         }
-        fx->file.list.pop_back();
     }
+
+    fx->file.free.clear();
+    fx->file.top = 1;
 }
 
-ysfx_file_t *ysfx_get_file(ysfx_t *fx, uint32_t handle, std::unique_lock<ysfx::mutex> &lock, std::unique_lock<ysfx::mutex> *list_lock)
+// the handle has the slot index in the low bits, and a generation above which
+// changes whenever the slot is reused, such that a stale handle does not
+// designate the new file
+static uint32_t ysfx_file_handle(ysfx_t *fx, uint32_t index, uint32_t generation)
 {
-    std::unique_lock<ysfx::mutex> local_list_lock;
-    if (list_lock)
-        *list_lock = std::unique_lock<ysfx::mutex>(fx->file.list_mutex);
-    else
-        local_list_lock = std::unique_lock<ysfx::mutex>(fx->file.list_mutex);
-    if (handle >= fx->file.list.size())
+    uint32_t index_bits = fx->file.index_bits;
+    uint32_t generation_mask = (1u << (31 - index_bits)) - 1;
+    return ((generation & generation_mask) << index_bits) | index;
+}
+
+ysfx_file_t *ysfx_get_file(ysfx_t *fx, uint32_t handle, std::unique_lock<ysfx::mutex> &lock)
+{
+    uint32_t index = handle & ((1u << fx->file.index_bits) - 1);
+    if (index >= fx->file.capacity)
         return nullptr;
-    ysfx_file_t *file = fx->file.list[handle].get();
-    if (!file)
+    ysfx_t::file_slot &slot = fx->file.slots[index];
+    std::unique_lock<ysfx::mutex> slot_lock{slot.mutex};
+    if (!slot.file || ysfx_file_handle(fx, index, slot.generation) != handle)
         return nullptr;
-    lock = std::unique_lock<ysfx::mutex>{*file->m_mutex};
-    return file;
+    lock = std::move(slot_lock);
+    return slot.file.get();
 }
 
 int32_t ysfx_insert_file(ysfx_t *fx, ysfx_file_t *file)
 {
-    std::lock_guard<ysfx::mutex> lock(fx->file.list_mutex);
+    std::lock_guard<ysfx::mutex> alloc_lock(fx->file.alloc_mutex);
 
-    //
-    size_t noneidx = ~(size_t)0;
-    size_t freeidx = noneidx;
+    uint32_t index;
+    if (!fx->file.free.empty()) {
+        index = fx->file.free.back();
+        fx->file.free.pop_back();
+    }
+    else if (fx->file.top < fx->file.capacity)
+        index = fx->file.top++;
+    else
+        return -1;
+
+    ysfx_t::file_slot &slot = fx->file.slots[index];
+    std::lock_guard<ysfx::mutex> lock(slot.mutex);
+    slot.file.reset(file);
+    fx->file.open_count.fetch_add(1, std::memory_order_relaxed);
+    return (int32_t)ysfx_file_handle(fx, index, slot.generation);
+}
 
-    for (size_t i = 0, n = fx->file.list.size(); i < n && freeidx == noneidx; ++i) {
-        if (!fx->file.list[i])
-            freeidx = i;
+bool ysfx_close_file(ysfx_t *fx, uint32_t handle)
+{
+    std::lock_guard<ysfx::mutex> alloc_lock(fx->file.alloc_mutex);
+
+    std::unique_lock<ysfx::mutex> lock;
+    if (!ysfx_get_file(fx, handle, lock))
+        return false;
+
+    uint32_t index = handle & ((1u << fx->file.index_bits) - 1);
+    ysfx_t::file_slot &slot = fx->file.slots[index];
+    slot.file.reset();
+    ++slot.generation;
+    fx->file.free.push_back(index);
+    fx->file.open_count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ysfx_touch_state(ysfx_t *fx)
+{
+    fx->state.generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+// the hash of the memory ranges which @serialize has saved, computed the
+// same way as the serializer does when it writes them
+static uint64_t ysfx_hash_state_ranges(ysfx_t *fx)
+{
+    ysfx::hash_stream hash;
+    NSEEL_VMCTX vm = fx->vm.get();
+    for (const std::pair<uint32_t, uint32_t> &range : fx->state.coverage.ranges) {
+        ysfx_eel_ram_reader reader{vm, range.first};
+        for (uint32_t left = range.second; left > 0; ) {
+            uint32_t count = left;
+            const EEL_F *src = reader.read_span(count);
+            if (src)
+                hash.update(src, (size_t)count * sizeof(EEL_F));
+            else
+                hash.update_zeros((size_t)count * sizeof(EEL_F));
+            left -= count;
+        }
+    }
+    return hash.digest();
+}
+
+// the hash of the sliders, of all the variables of the code, and of the
+// variables and memory which @serialize has saved
+//   all the variables are included, because @serialize can save the value
+//   of one after copying it into another, such as a temporary
+static uint64_t ysfx_hash_state(ysfx_t *fx, uint64_t ranges_hash)
+{
+    ysfx::hash_stream hash;
+
+    for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
+        hash.update(fx->var.slider[i], sizeof(EEL_F));
+
+    // without @serialize, the sliders are all the state
+    if (!fx->has_serialize)
+        return hash.digest();
+
+    const ysfx_s::reset_plan &plan = fx->code.reset;
+    if (plan.var_count == ysfx_get_var_count(fx->vm.get())) {
+        for (const ysfx_s::reset_plan::run &run : plan.runs)
+            hash.update(run.start, run.count * sizeof(EEL_F));
     }
-    if (freeidx != noneidx) {
-        fx->file.list[freeidx].reset(file);
-        return (uint32_t)freeidx;
+    else {
+        // variables were registered since the plan was made
+        struct hash_data {
+            const ysfx_s::reset_plan *plan = nullptr;
+            ysfx::hash_stream *hash = nullptr;
+        };
+        hash_data hd{&plan, &hash};
+        auto callback = [](const char *name, EEL_F *var, void *userdata) -> int {
+            hash_data *hd = (hash_data *)userdata;
+            if (ysfx_is_reset_var(*hd->plan, name, var))
+                hd->hash->update(var, sizeof(EEL_F));
+            return 1;
+        };
+        NSEEL_VM_enumallvars(fx->vm.get(), +callback, &hd);
     }
 
-    enum { max_file_handles = 64 };
+    // the variables can also be memory, passed to file_var as `x[i]`
+    for (ysfx_real *var : fx->state.coverage.vars)
+        hash.update(var, sizeof(EEL_F));
 
-    size_t pos = fx->file.list.size();
-    if (pos >= max_file_handles)
-        return -1;
+    hash.update(&ranges_hash, sizeof(ranges_hash));
+    return hash.digest();
+}
+
+uint64_t ysfx_get_state_generation(ysfx_t *fx)
+{
+    if (!fx->code.compiled)
+        return fx->state.generation.load(std::memory_order_relaxed);
+
+    std::lock_guard<ysfx::mutex> lock{fx->state.mutex};
 
-    fx->file.list.emplace_back(file);
-    return (uint32_t)pos;
+    // if the state was not saved yet, or too large to watch, it is
+    // assumed to change every time
+    uint64_t hash = ysfx_hash_state(fx, ysfx_hash_state_ranges(fx));
+    if (!fx->state.complete || hash != fx->state.hash) {
+        fx->state.hash = hash;
+        ysfx_touch_state(fx);
+    }
+
+    return fx->state.generation.load(std::memory_order_relaxed);
 }
 
 bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state)
@@ -1643,9 +1932,6 @@ bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state)
     if (!fx->code.compiled)
         return false;
 
-    // restore the serialization
-    std::string buffer((char *)state->data, state->data_size);
-
     // restore the sliders
     for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
         *fx->var.slider[i] = fx->source.main->header.sliders[i].def;
@@ -1655,6 +1941,7 @@ bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state)
         if (j < ysfx_max_sliders && fx->source.main->header.sliders[j].exists)
             *fx->var.slider[j] = state->sliders[i].value;
     }
+    ysfx_prefetch_all_slider_files(fx);
     fx->must_compute_slider = true;
 
     // invoke @serialize
@@ -1662,13 +1949,14 @@ bool ysfx_load_state(ysfx_t *fx, ysfx_state_t *state)
         std::unique_lock<ysfx::mutex> lock;
         ysfx_serializer_t *serializer = static_cast<ysfx_serializer_t *>(ysfx_get_file(fx, 0, lock));
         assert(serializer);
-        serializer->begin(false, buffer);
+        serializer->begin_read(state->data, state->data_size);
         lock.unlock();
         ysfx_serialize(fx);
         lock.lock();
         serializer->end();
     }
 
+    ysfx_touch_state(fx);
     return true;
 }
 
@@ -1676,21 +1964,19 @@ bool ysfx_load_serialized_state(ysfx_t *fx, ysfx_state_t *state)
 {
     if (!fx->code.compiled) return false;
 
-    // restore the serialization
-    std::string buffer((char *)state->data, state->data_size);
-
     // invoke @serialize
     {
         std::unique_lock<ysfx::mutex> lock;
         ysfx_serializer_t *serializer = static_cast<ysfx_serializer_t *>(ysfx_get_file(fx, 0, lock));
         assert(serializer);
-        serializer->begin(false, buffer);
+        serializer->begin_read(state->data, state->data_size);
         lock.unlock();
         ysfx_serialize(fx);
         lock.lock();
         serializer->end();
     }
 
+    ysfx_touch_state(fx);
     return true;
 }
 
@@ -1699,17 +1985,35 @@ ysfx_state_t *ysfx_save_state(ysfx_t *fx)
     if (!fx->code.compiled)
         return nullptr;
 
-    std::string buffer;
+    std::unique_ptr<uint8_t[]> data;
+    size_t data_size = 0;
 
     // invoke @serialize
     {
         std::unique_lock<ysfx::mutex> lock;
         ysfx_serializer_t *serializer = static_cast<ysfx_serializer_t *>(ysfx_get_file(fx, 0, lock));
         assert(serializer);
-        serializer->begin(true, buffer);
+        serializer->begin_write();
         lock.unlock();
         ysfx_serialize(fx);
         lock.lock();
+        data = serializer->take_output(data_size);
+
+        // remember what was saved, to check it for changes later
+        std::lock_guard<ysfx::mutex> state_lock{fx->state.mutex};
+        const ysfx_serializer_t::coverage_t &coverage = serializer->coverage();
+        fx->state.coverage.vars.assign(coverage.vars.begin(), coverage.vars.end());
+        fx->state.coverage.ranges.assign(coverage.ranges.begin(), coverage.ranges.end());
+        fx->state.complete = fx->state.traceable && !coverage.overflow;
+
+        // a change since the last poll of the generation is not seen by the
+        // next one, which compares against this hash, so report it here
+        //   the memory was hashed by the serializer as it wrote it
+        uint64_t hash = ysfx_hash_state(fx, coverage.ranges_hash);
+        if (hash != fx->state.hash)
+            ysfx_touch_state(fx);
+        fx->state.hash = hash;
+
         serializer->end();
     }
 
@@ -1730,10 +2034,9 @@ ysfx_state_t *ysfx_save_state(ysfx_t *fx)
         }
     }
 
-    // save the serialization
-    state->data_size = buffer.size();
-    state->data = new uint8_t[state->data_size];
-    memcpy(state->data, buffer.data(), state->data_size);
+    // save the serialization, the buffer is handed over without copy
+    state->data_size = data_size;
+    state->data = data ? data.release() : new uint8_t[0];
 
     //
     return state.release();
@@ -1808,8 +2111,99 @@ void ysfx_enum_vars(ysfx_t *fx, ysfx_enum_vars_callback_t *callback, void *userd
     NSEEL_VM_enumallvars(fx->vm.get(), callback, userdata);
 }
 
+static std::string ysfx_fold_var_name(const char *name)
+{
+    std::string folded{name};
+    for (char &c : folded)
+        c = ysfx::ascii_tolower(c);
+    return folded;
+}
+
+static bool ysfx_is_var_index_current(ysfx_t *fx)
+{
+    const ysfx_s::var_index &index = fx->code.vars;
+    return fx->code.compiled && index.var_count == ysfx_get_var_count(fx->vm.get());
+}
+
+static void ysfx_build_var_index(NSEEL_VMCTX vm, ysfx_s::var_index &index)
+{
+    index = {};
+
+    size_t count = ysfx_get_var_count(vm);
+    index.by_name.reserve(count);
+    index.entries.reserve(count);
+
+    NSEEL_VM_enumallvars(vm, +[](const char *name, EEL_F *var, void *userdata) -> int {
+        ysfx_s::var_index &index = *(ysfx_s::var_index *)userdata;
+        index.by_name.emplace(std::string_view(name), var);
+        ysfx_s::var_index::entry ent;
+        ent.folded_name = ysfx_fold_var_name(name);
+        ent.name = name;
+        ent.var = var;
+        index.entries.push_back(std::move(ent));
+        return 1;
+    }, &index);
+
+    std::sort(
+        index.entries.begin(), index.entries.end(),
+        [](const ysfx_s::var_index::entry &a, const ysfx_s::var_index::entry &b) -> bool {
+            return a.folded_name < b.folded_name;
+        });
+
+    index.var_count = count;
+}
+
+void ysfx_build_var_index(ysfx_t *fx)
+{
+    ysfx_build_var_index(fx->vm.get(), fx->code.vars);
+}
+
+void ysfx_search_vars(ysfx_t *fx, const char *pattern, ysfx_var_search_mode_t mode, ysfx_enum_vars_callback_t *callback, void *userdata)
+{
+    // variables registered after compilation are not indexed; don't modify
+    // the index here, in case another thread uses it, but search a copy
+    bool current = ysfx_is_var_index_current(fx);
+    ysfx_s::var_index temp_index;
+    if (!current)
+        ysfx_build_var_index(fx->vm.get(), temp_index);
+
+    const ysfx_s::var_index &index = current ? fx->code.vars : temp_index;
+    const std::string folded = ysfx_fold_var_name(pattern ? pattern : "");
+
+    switch (mode) {
+    case ysfx_var_search_prefix: {
+        auto it = std::lower_bound(
+            index.entries.begin(), index.entries.end(), folded,
+            [](const ysfx_s::var_index::entry &ent, const std::string &key) -> bool {
+                return ent.folded_name < key;
+            });
+        for (; it != index.entries.end(); ++it) {
+            if (it->folded_name.compare(0, folded.size(), folded) != 0)
+                break;
+            if (!callback(it->name, it->var, userdata))
+                break;
+        }
+        break;
+    }
+    case ysfx_var_search_substring:
+        for (const ysfx_s::var_index::entry &ent : index.entries) {
+            if (ent.folded_name.find(folded) == std::string::npos)
+                continue;
+            if (!callback(ent.name, ent.var, userdata))
+                break;
+        }
+        break;
+    }
+}
+
 ysfx_real *ysfx_find_var(ysfx_t *fx, const char *name)
 {
+    if (ysfx_is_var_index_current(fx)) {
+        const ysfx_s::var_index &index = fx->code.vars;
+        auto it = index.by_name.find(std::string_view(name));
+        return (it != index.by_name.end()) ? it->second : nullptr;
+    }
+
     struct find_data {
         ysfx_real *var = nullptr;
         const char *name = nullptr;
@@ -1848,17 +2242,25 @@ ysfx_real ysfx_read_vmem_single(ysfx_t *fx, uint32_t addr)
 
 int ysfx_calculate_used_mem(ysfx_t *fx)
 {
-    int validCount{0};
-    uint32_t addr{0};
-    int usedMemory{0};
+    // the VM counts its blocks as they are allocated and freed
+    return NSEEL_VM_getramusedblocks(fx->vm.get()) * NSEEL_RAM_ITEMSPERBLOCK;
+}
 
-    for (uint32_t i = 0; i < UINT32_MAX / NSEEL_RAM_ITEMSPERBLOCK; i++) {
-        NSEEL_VM_getramptr_noalloc(fx->vm.get(), addr, &validCount);
-        addr += NSEEL_RAM_ITEMSPERBLOCK;
-        usedMemory += validCount;
-    }
-    
-    return usedMemory;
+void ysfx_get_memory_stats(ysfx_t *fx, uint32_t flags, ysfx_memory_stats_t *stats)
+{
+    constexpr uint64_t block_bytes = NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+
+    // the figures are counters kept as the memory is allocated and freed,
+    // except the strings, which the DSP thread would have to wait for
+    *stats = ysfx_memory_stats_t{};
+    stats->vm_bytes = (uint64_t)NSEEL_VM_getramusedblocks(fx->vm.get()) * block_bytes;
+    stats->gmem_bytes = (uint64_t)get_gmem_used_blocks(fx) * block_bytes;
+    if (flags & ysfx_memory_stats_strings)
+        stats->string_bytes = ysfx_string_memory(fx);
+#if !defined(YSFX_NO_GFX)
+    stats->image_bytes = fx->gfx.image_bytes.load(std::memory_order_relaxed);
+#endif
+    stats->file_handles = fx->file.open_count.load(std::memory_order_relaxed);
 }
 
 bool ysfx_find_data_file(ysfx_t *fx, EEL_F *file, std::string &result)
@@ -1899,6 +2301,11 @@ bool ysfx_find_data_file(ysfx_t *fx, EEL_F *file, std::string &result)
     else
         return false;
 
+    return ysfx_find_data_file_part(fx, filepart, accept_absolute, accept_relative, result);
+}
+
+bool ysfx_find_data_file_part(ysfx_t *fx, const std::string &filepart, bool accept_absolute, bool accept_relative, std::string &result)
+{
     std::vector<std::string> filecandidates;
     filecandidates.reserve(2);
 
@@ -2064,3 +2471,19 @@ bool ysfx_gfx_run(ysfx_t *fx)
     return false;
 #endif
 }
+
+uint32_t ysfx_gfx_get_dirty_rects(ysfx_t *fx, ysfx_gfx_rect_t *rects, uint32_t max)
+{
+#if !defined(YSFX_NO_GFX)
+    ysfx_scoped_gfx_t scope{fx, false};
+    ysfx_gfx_state_t *state = ysfx_gfx_get_context(fx);
+    if (!state)
+        return 0;
+    return ysfx_gfx_state_get_dirty_rects(state, rects, max);
+#else
+    (void)fx;
+    (void)rects;
+    (void)max;
+    return 0;
+#endif
+}
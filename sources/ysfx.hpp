@@ -25,9 +25,11 @@
 #include "ysfx_api_gfx.hpp"
 #include "ysfx_utils.hpp"
 #include "utility/sync_bitset.hpp"
+#include "utility/alias_table.hpp"
 #include "WDL/eel2/ns-eel.h"
 #include "WDL/eel2/ns-eel-int.h"
 #include <unordered_map>
+#include <string_view>
 #include <atomic>
 
 YSFX_DEFINE_AUTO_PTR(NSEEL_VMCTX_u, void, NSEEL_VM_free); // NOTE: `NSEEL_VMCTX` is `void *`
@@ -55,7 +57,7 @@ enum ysfx_thread_id_t {
 struct ysfx_s {
     ysfx_config_u config;
     eel_string_context_state_u string_ctx;
-    ysfx::mutex string_mutex;
+    ysfx::biased_mutex string_mutex;
     ysfx::mutex atomic_mutex;
     ysfx::mutex image_mutex;
     NSEEL_VMCTX_u vm;
@@ -84,12 +86,46 @@ struct ysfx_s {
         std::string bank_path;
         ysfx_source_unit_u main;
         std::vector<ysfx_source_unit_u> imports;
-        std::unordered_map<std::string, uint32_t> slider_alias;
+        ysfx::alias_table slider_alias;
+        // decodable files of the file sliders, by enum value (null path if not)
+        std::vector<ysfx_audio_prefetch_t> slider_files[ysfx_max_sliders];
+        std::shared_ptr<ysfx_audio_prefetcher_t> prefetcher;
     } source;
 
+    // variable index, built after compilation
+    struct var_index {
+        struct entry {
+            std::string folded_name;
+            const char *name = nullptr;
+            EEL_F *var = nullptr;
+        };
+        // the keys are views of the names held by the VM, so that lookups
+        // don't need to make a string of the name
+        std::unordered_map<std::string_view, ysfx_real *> by_name;
+        // sorted by folded name
+        std::vector<entry> entries;
+        // size of the VM variable table at the time of indexing
+        size_t var_count = 0;
+    };
+
+    // variables to zero on re-@init, as contiguous runs of values
+    struct reset_plan {
+        struct run {
+            EEL_F *start = nullptr;
+            size_t count = 0;
+        };
+        std::vector<run> runs;
+        // the built-in variables, sorted by address
+        std::vector<ysfx_real *> builtins;
+        // size of the VM variable table at the time of planning
+        size_t var_count = 0;
+    };
+
     // compilation
     struct {
         bool compiled = false;
+        var_index vars;
+        reset_plan reset;
         std::vector<NSEEL_CODEHANDLE_u> init;
         NSEEL_CODEHANDLE_u slider;
         NSEEL_CODEHANDLE_u block;
@@ -161,15 +197,46 @@ struct ysfx_s {
     // Triggers
     uint32_t triggers = 0;
 
+    // State changes
+    //   the generation increases on the known changes, and when polled, if
+    //   the sliders, the variables, or the memory which @serialize has saved
+    //   last time have a different hash
+    struct {
+        std::atomic<uint64_t> generation{0};
+        ysfx::mutex mutex;
+        ysfx_serializer_t::coverage_t coverage;
+        // whether the coverage is known to be all the state
+        bool complete = false;
+        // whether @serialize reads no memory that the coverage misses
+        bool traceable = false;
+        uint64_t hash = 0;
+    } state;
+
     // Files
+    //   the slots are allocated once, so a handle resolves to its slot without
+    //   locking the table, and the slot mutex serializes the threads using it
+    struct file_slot {
+        ysfx::mutex mutex;
+        ysfx_file_u file;
+        uint32_t generation = 0;
+    };
     struct {
-        std::vector<ysfx_file_u> list;
-        ysfx::mutex list_mutex;
+        std::unique_ptr<file_slot[]> slots;
+        uint32_t capacity = 0;
+        uint32_t index_bits = 0;
+        // closed slots to reuse, then the ones never used from `top` onwards
+        std::vector<uint32_t> free;
+        uint32_t top = 1;
+        ysfx::mutex alloc_mutex;
+        // files open in the slots, for the statistics
+        std::atomic<uint32_t> open_count{0};
     } file;
 
 #if !defined(YSFX_NO_GFX)
     // Graphics
     struct {
+        // bytes of pixels in the images of the effect, for the statistics
+        std::atomic<uint64_t> image_bytes{0};
         ysfx_gfx_state_u state;
         ysfx::mutex mutex;
         volatile bool ready = false;
@@ -180,7 +247,8 @@ struct ysfx_s {
 
     std::atomic<uint32_t> ref_count{1};
 
-    std::string gmem_name{""};
+    // attached gmem namespace, null for the default NSEEL gmem
+    struct ysfx_gmem_context *gmem = nullptr;
 };
 
 ysfx_thread_id_t ysfx_get_thread_id();
@@ -188,17 +256,25 @@ void ysfx_set_thread_id(ysfx_thread_id_t id);
 void ysfx_unload_source(ysfx_t *fx);
 void ysfx_unload_code(ysfx_t *fx);
 void ysfx_first_init(ysfx_t *fx);
+void ysfx_touch_state(ysfx_t *fx);
+void ysfx_build_var_index(ysfx_t *fx);
+void ysfx_build_reset_plan(ysfx_t *fx);
 void ysfx_update_slider_visibility_mask(ysfx_t *fx);
 void ysfx_fill_file_enums(ysfx_t *fx);
+void ysfx_fill_slider_files(ysfx_t *fx);
+void ysfx_prefetch_slider_files(ysfx_t *fx, uint32_t index, bool replace = true);
+void ysfx_prefetch_all_slider_files(ysfx_t *fx);
 void ysfx_fix_invalid_enums(ysfx_t *fx);
 ysfx_section_t *ysfx_search_section(ysfx_t *fx, uint32_t type, ysfx_toplevel_t **origin = nullptr);
 std::string ysfx_resolve_import_path(ysfx_t *fx, const std::string &name, const std::string &origin);
 uint32_t ysfx_current_midi_bus(ysfx_t *fx);
 void ysfx_clear_files(ysfx_t *fx);
-ysfx_file_t *ysfx_get_file(ysfx_t *fx, uint32_t handle, std::unique_lock<ysfx::mutex> &lock, std::unique_lock<ysfx::mutex> *list_lock = nullptr);
+ysfx_file_t *ysfx_get_file(ysfx_t *fx, uint32_t handle, std::unique_lock<ysfx::mutex> &lock);
 int32_t ysfx_insert_file(ysfx_t *fx, ysfx_file_t *file);
+bool ysfx_close_file(ysfx_t *fx, uint32_t handle);
 void ysfx_serialize(ysfx_t *fx);
 uint32_t ysfx_get_slider_of_var(ysfx_t *fx, EEL_F *var);
 bool ysfx_find_data_file(ysfx_t *fx, EEL_F *file, std::string &result);
+bool ysfx_find_data_file_part(ysfx_t *fx, const std::string &filepart, bool accept_absolute, bool accept_relative, std::string &result);
 ysfx_file_type_t ysfx_detect_file_type(ysfx_t *fx, const char *path, void **fmtobj);
 void ysfx_set_window_state(ysfx_t *fx, bool hasFocus, bool windowVisible, bool mouseOver);
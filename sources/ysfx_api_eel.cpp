@@ -21,6 +21,7 @@
 #include "ysfx.hpp"
 #include "ysfx_api_eel.hpp"
 #include "ysfx_utils.hpp"
+#include "utility/atomic_cell.hpp"
 #include <cstring>
 #include <cstdlib>
 #include <cstddef>
@@ -33,8 +34,6 @@
 #   define EEL_STRING_STDOUT_WRITE(x,len) { fwrite(x,len,1,stdout); fflush(stdout); }
 #endif
 
-//TODO: thread-safety considerations with strings
-
 #define EEL_STRING_MAXUSERSTRING_LENGTH_HINT ysfx_string_max_length
 
 static ysfx::mutex atomic_mutex;
@@ -46,7 +45,112 @@ static ysfx::mutex atomic_mutex;
 #include "WDL/eel2/eel_misc.h"
 #include "WDL/eel2/eel_fft.h"
 #include "WDL/eel2/eel_mdct.h"
-#include "WDL/eel2/eel_atomic.h"
+
+//------------------------------------------------------------------------------
+// NOTE: replacements of `eel_atomic.h`, which operate on the cells with CPU
+//   atomics, and use the mutex only for cells which are not suitably aligned.
+//   `atomic_exch` takes the mutex in any case, to exchange its 2 cells as a
+//   whole with respect to other `atomic_exch`.
+
+static EEL_F NSEEL_CGEN_CALL ysfx_atomic_setifeq(void *opaque, EEL_F *a, EEL_F *cmp, EEL_F *nd)
+{
+    if (!ysfx::atomic_cell_is_lock_free(a)) {
+        EEL_F ret;
+        EEL_ATOMIC_SET_SCOPE(opaque)
+        EEL_ATOMIC_ENTER;
+        ret = *a;
+        if (fabs(ret - *cmp) < NSEEL_CLOSEFACTOR) *a = *nd;
+        EEL_ATOMIC_LEAVE;
+        return ret;
+    }
+
+    uint64_t bits = ysfx::atomic_cell_load_bits(a);
+    uint64_t desired = ysfx::atomic_cell_value_to_bits(*nd);
+    EEL_F ret;
+    do {
+        ret = ysfx::atomic_cell_bits_to_value(bits);
+        if (!(fabs(ret - *cmp) < NSEEL_CLOSEFACTOR))
+            break;
+    } while (!ysfx::atomic_cell_compare_exchange_bits(a, bits, desired));
+    return ret;
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_atomic_exch(void *opaque, EEL_F *a, EEL_F *b)
+{
+    EEL_F tmp;
+    EEL_ATOMIC_SET_SCOPE(opaque)
+    EEL_ATOMIC_ENTER;
+    if (ysfx::atomic_cell_is_lock_free(a) && ysfx::atomic_cell_is_lock_free(b)) {
+        tmp = ysfx::atomic_cell_load(b);
+        ysfx::atomic_cell_exchange(b, ysfx::atomic_cell_exchange(a, tmp));
+    }
+    else {
+        tmp = *b;
+        *b = *a;
+        *a = tmp;
+    }
+    EEL_ATOMIC_LEAVE;
+    return tmp;
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_atomic_add(void *opaque, EEL_F *a, EEL_F *b)
+{
+    if (!ysfx::atomic_cell_is_lock_free(a)) {
+        EEL_F tmp;
+        EEL_ATOMIC_SET_SCOPE(opaque)
+        EEL_ATOMIC_ENTER;
+        tmp = (*a += *b);
+        EEL_ATOMIC_LEAVE;
+        return tmp;
+    }
+
+    EEL_F increment = *b;
+    uint64_t bits = ysfx::atomic_cell_load_bits(a);
+    EEL_F tmp;
+    do
+        tmp = ysfx::atomic_cell_bits_to_value(bits) + increment;
+    while (!ysfx::atomic_cell_compare_exchange_bits(a, bits, ysfx::atomic_cell_value_to_bits(tmp)));
+    return tmp;
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_atomic_set(void *opaque, EEL_F *a, EEL_F *b)
+{
+    if (!ysfx::atomic_cell_is_lock_free(a)) {
+        EEL_F tmp;
+        EEL_ATOMIC_SET_SCOPE(opaque)
+        EEL_ATOMIC_ENTER;
+        tmp = *a = *b;
+        EEL_ATOMIC_LEAVE;
+        return tmp;
+    }
+
+    EEL_F tmp = *b;
+    ysfx::atomic_cell_exchange(a, tmp);
+    return tmp;
+}
+
+static EEL_F NSEEL_CGEN_CALL ysfx_atomic_get(void *opaque, EEL_F *a)
+{
+    if (!ysfx::atomic_cell_is_lock_free(a)) {
+        EEL_F tmp;
+        EEL_ATOMIC_SET_SCOPE(opaque)
+        EEL_ATOMIC_ENTER;
+        tmp = *a;
+        EEL_ATOMIC_LEAVE;
+        return tmp;
+    }
+
+    return ysfx::atomic_cell_load(a);
+}
+
+static void ysfx_atomic_register()
+{
+    NSEEL_addfunc_retval("atomic_setifequal", 3, NSEEL_PProc_THIS, &ysfx_atomic_setifeq);
+    NSEEL_addfunc_retval("atomic_exch", 2, NSEEL_PProc_THIS, &ysfx_atomic_exch);
+    NSEEL_addfunc_retval("atomic_add", 2, NSEEL_PProc_THIS, &ysfx_atomic_add);
+    NSEEL_addfunc_retval("atomic_set", 2, NSEEL_PProc_THIS, &ysfx_atomic_set);
+    NSEEL_addfunc_retval("atomic_get", 1, NSEEL_PProc_THIS, &ysfx_atomic_get);
+}
 
 //------------------------------------------------------------------------------
 void ysfx_api_init_eel()
@@ -56,7 +160,7 @@ void ysfx_api_init_eel()
     EEL_mdct_register();
     EEL_string_register();
     EEL_misc_register();
-    EEL_atomic_register();
+    ysfx_atomic_register();
 }
 
 //------------------------------------------------------------------------------
@@ -119,14 +223,48 @@ bool ysfx_string_set(ysfx_t *fx, ysfx_real id, const std::string &txt)
     }, (void *)&txt);
 }
 
+uint64_t ysfx_string_memory(ysfx_t *fx)
+{
+    void *opaque = fx;
+    eel_string_context_state *ctx = EEL_STRING_GET_CONTEXT_POINTER(opaque);
+    EEL_STRING_MUTEXLOCK_SCOPE
+
+    uint64_t total = 0;
+    auto add_list = [&total](const WDL_PtrList<EEL_STRING_STORAGECLASS> &list) {
+        for (int i = 0, n = list.GetSize(); i < n; ++i) {
+            if (const EEL_STRING_STORAGECLASS *str = list.Get(i))
+                total += (uint32_t)str->GetLength();
+        }
+    };
+    add_list(ctx->m_literal_strings);
+    add_list(ctx->m_unnamed_strings);
+    add_list(ctx->m_named_strings);
+    for (const EEL_STRING_STORAGECLASS *str : ctx->m_user_strings) {
+        if (str)
+            total += (uint32_t)str->GetLength();
+    }
+
+    return total;
+}
+
+// NOTE: the DSP thread takes the lock-free path, and other threads (@gfx,
+//   host calls) wait for it; the DSP thread only blocks if one of those is
+//   inside a string operation at the same moment.
+
 void ysfx_string_lock(ysfx_t *fx)
 {
-    fx->string_mutex.lock();
+    if (ysfx_get_thread_id() == ysfx_thread_id_dsp)
+        fx->string_mutex.lock_fast();
+    else
+        fx->string_mutex.lock();
 }
 
 void ysfx_string_unlock(ysfx_t *fx)
 {
-    fx->string_mutex.unlock();
+    if (ysfx_get_thread_id() == ysfx_thread_id_dsp)
+        fx->string_mutex.unlock_fast();
+    else
+        fx->string_mutex.unlock();
 }
 
 void ysfx_image_lock(ysfx_t *fx)
@@ -43,6 +43,7 @@ enum { ysfx_string_max_length = 1 << 16 };
 bool ysfx_string_access(ysfx_t *fx, ysfx_real id, bool for_write, void (*access)(void *, WDL_FastString &), void *userdata);
 bool ysfx_string_get(ysfx_t *fx, ysfx_real id, std::string &txt);
 bool ysfx_string_set(ysfx_t *fx, ysfx_real id, const std::string &txt);
+uint64_t ysfx_string_memory(ysfx_t *fx);
 void ysfx_string_lock(ysfx_t *fx);
 void ysfx_string_unlock(ysfx_t *fx);
 void ysfx_image_lock(ysfx_t *fx);
@@ -29,51 +29,70 @@
 ysfx_raw_file_t::ysfx_raw_file_t(NSEEL_VMCTX vm, const char *filename)
     : m_vm(vm),
       m_stream(ysfx::fopen_utf8(filename, "rb"))
-{
-}
-
-int32_t ysfx_raw_file_t::avail()
 {
     if (!m_stream)
-        return 0;
+        return;
 
-    int64_t cur_off = ysfx::ftell_lfs(m_stream.get());
-    if (cur_off == -1)
-        return 0;
+    if (ysfx::map_stream_file(m_stream.get(), m_map)) {
+        m_size = m_map.size;
+        m_stream.reset();
+        return;
+    }
 
-    if (ysfx::fseek_lfs(m_stream.get(), 0, SEEK_END) == -1)
-        return 0;
+    // measure once, so that `avail` only needs to know the position
+    int64_t end_off = -1;
+    if (ysfx::fseek_lfs(m_stream.get(), 0, SEEK_END) == 0)
+        end_off = ysfx::ftell_lfs(m_stream.get());
+    ::rewind(m_stream.get());
+    m_size = (end_off > 0) ? (uint64_t)end_off : 0;
+}
 
-    int64_t end_off = ysfx::ftell_lfs(m_stream.get());
-    if (end_off == -1)
-        return 0;
+ysfx_raw_file_t::~ysfx_raw_file_t()
+{
+    ysfx::unmap_file(m_map);
+}
 
-    if (ysfx::fseek_lfs(m_stream.get(), cur_off, SEEK_SET) == -1)
+int32_t ysfx_raw_file_t::avail()
+{
+    if (!is_open())
         return 0;
 
-    if ((uint64_t)end_off < (uint64_t)cur_off)
+    if (m_stream) {
+        int64_t cur_off = ysfx::ftell_lfs(m_stream.get());
+        if (cur_off == -1)
+            return 0;
+        m_pos = (uint64_t)cur_off;
+    }
+
+    if (m_size < m_pos)
         return 0;
 
-    uint64_t byte_count = (uint64_t)end_off - (uint64_t)cur_off;
+    uint64_t byte_count = m_size - m_pos;
     uint64_t f32_count = byte_count / 4;
     return (f32_count > 0x7fffffff) ? 0x7fffffff : (uint32_t)f32_count;
 }
 
 void ysfx_raw_file_t::rewind()
 {
-    if (!m_stream)
-        return;
+    m_pos = 0;
 
-    ::rewind(m_stream.get());
+    if (m_stream)
+        ::rewind(m_stream.get());
 }
 
 bool ysfx_raw_file_t::var(ysfx_real *var)
 {
-    if (!m_stream)
+    if (!is_open())
         return false;
 
     uint8_t data[4];
-    if (fread(data, 1, 4, m_stream.get()) != 4)
+    if (m_map.data) {
+        if (m_size - m_pos < 4)
+            return false;
+        memcpy(data, m_map.data + m_pos, 4);
+        m_pos += 4;
+    }
+    else if (fread(data, 1, 4, m_stream.get()) != 4)
         return false;
 
     *var = (EEL_F)ysfx::unpack_f32le(data);
@@ -82,34 +101,70 @@ bool ysfx_raw_file_t::var(ysfx_real *var)
 
 uint32_t ysfx_raw_file_t::mem(uint32_t offset, uint32_t length)
 {
-    if (!m_stream)
+    if (!is_open())
         return 0;
 
     ysfx_eel_ram_writer writer{m_vm, offset};
 
-    uint32_t read;
-    for (read = 0; read < length; ++read) {
-        ysfx_real value;
-        if (!var(&value))
-            break;
-        writer.write_next(value);
+    if (!m_map.data) {
+        uint32_t read;
+        for (read = 0; read < length; ++read) {
+            ysfx_real value;
+            if (!var(&value))
+                break;
+            writer.write_next(value);
+        }
+        return read;
     }
 
-    return read;
+    uint64_t f32_avail = (m_size - m_pos) / 4;
+    if (length > f32_avail)
+        length = (uint32_t)f32_avail;
+
+    // convert straight into the VM blocks, one contiguous span at a time
+    const uint8_t *src = m_map.data + m_pos;
+    for (uint32_t left = length; left > 0; ) {
+        uint32_t count = left;
+        EEL_F *dest = writer.write_span(count);
+        if (dest)
+            ysfx::unpack_f32le_block(src, dest, count);
+        src += 4 * (size_t)count;
+        left -= count;
+    }
+
+    m_pos += 4 * (uint64_t)length;
+    return length;
 }
 
 uint32_t ysfx_raw_file_t::string(std::string &str)
 {
-    if (!m_stream)
+    if (!is_open())
         return 0;
 
     uint8_t data[4];
-    if (fread(data, 1, 4, m_stream.get()) != 4)
+    if (m_map.data) {
+        if (m_size - m_pos < 4)
+            return 0;
+        memcpy(data, m_map.data + m_pos, 4);
+        m_pos += 4;
+    }
+    else if (fread(data, 1, 4, m_stream.get()) != 4)
         return 0;
 
     str.clear();
 
     uint32_t srclen = ysfx::unpack_u32le(data);
+
+    if (m_map.data) {
+        uint64_t count = m_size - m_pos;
+        if (count > srclen)
+            count = srclen;
+        const char *src = (const char *)(m_map.data + m_pos);
+        str.assign(src, (count < ysfx_string_max_length) ? (size_t)count : (size_t)ysfx_string_max_length);
+        m_pos += count;
+        return (uint32_t)count;
+    }
+
     str.reserve((srclen < ysfx_string_max_length) ? srclen : ysfx_string_max_length);
 
     uint32_t count = 0;
@@ -134,7 +189,7 @@ int32_t ysfx_text_file_t::avail()
     if (!m_stream || ferror(m_stream.get()))
         return -1;
 
-    return (feof(m_stream.get()) == 0) ? 1 : 0;
+    return m_eof ? 0 : 1;
 }
 
 void ysfx_text_file_t::rewind()
@@ -143,6 +198,66 @@ void ysfx_text_file_t::rewind()
         return;
 
     ::rewind(m_stream.get());
+    m_input_pos = 0;
+    m_input_end = 0;
+    m_eof = false;
+}
+
+bool ysfx_text_file_t::fill_input()
+{
+    m_input_pos = 0;
+    m_input_end = fread(m_input.get(), 1, input_size, m_stream.get());
+    if (m_input_end == 0)
+        m_eof = true;
+    return m_input_end > 0;
+}
+
+int ysfx_text_file_t::next_char()
+{
+    if (m_input_pos == m_input_end && !fill_input())
+        return EOF;
+    return (unsigned char)m_input[m_input_pos++];
+}
+
+bool ysfx_text_file_t::next_token(const char *&first, const char *&last)
+{
+    // get the next text separated by newline or comma, return false at the end
+    // the token is in the input buffer if it fits, or else copied in `m_buf`
+    bool spanning = false;
+    m_buf.clear();
+
+    for (;;) {
+        if (m_input_pos == m_input_end && !fill_input()) {
+            first = m_buf.data();
+            last = first + m_buf.size();
+            return false;
+        }
+
+        const char *start = m_input.get() + m_input_pos;
+        const char *end = m_input.get() + m_input_end;
+        const char *sep = start;
+        while (sep != end && *sep != '\n' && *sep != ',')
+            ++sep;
+
+        if (sep == end) {
+            m_buf.append(start, end);
+            m_input_pos = m_input_end;
+            spanning = true;
+            continue;
+        }
+
+        m_input_pos += (size_t)(sep - start) + 1;
+        if (!spanning) {
+            first = start;
+            last = sep;
+        }
+        else {
+            m_buf.append(start, sep);
+            first = m_buf.data();
+            last = first + m_buf.size();
+        }
+        return true;
+    }
 }
 
 bool ysfx_text_file_t::var(ysfx_real *var)
@@ -152,21 +267,20 @@ bool ysfx_text_file_t::var(ysfx_real *var)
 
     //TODO support the expression language for arithmetic
 
-    int ch;
+    bool more;
     do {
         // get the next number separated by newline or comma
         // but skip invalid lines
-        m_buf.clear();
-        while ((ch = fgetc(m_stream.get())) != EOF && ch != '\n' && ch != ',')
-            m_buf.push_back((unsigned char)ch);
-        const char *startp = m_buf.c_str();
-        const char *endp = (char *)startp;
-        double value = ysfx::dot_strtod(startp, (char **)&endp);
-        if (endp != startp) {
+        const char *startp;
+        const char *endp;
+        more = next_token(startp, endp);
+        const char *numendp = startp;
+        double value = ysfx::dot_strtod_n(startp, endp, &numendp);
+        if (numendp != startp) {
             *var = (EEL_F)value;
             return true;
         }
-    } while (ch != EOF);
+    } while (more);
 
     return false;
 }
@@ -178,12 +292,19 @@ uint32_t ysfx_text_file_t::mem(uint32_t offset, uint32_t length)
 
     ysfx_eel_ram_writer writer{m_vm, offset};
 
-    uint32_t read;
-    for (read = 0; read < length; ++read) {
-        ysfx_real value;
-        if (!var(&value))
-            break;
-        writer.write_next(value);
+    // parse straight into the VM blocks, one contiguous span at a time
+    uint32_t read = 0;
+    while (read < length) {
+        uint32_t count = length - read;
+        EEL_F *dest = writer.write_span(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            ysfx_real value;
+            if (!var(&value))
+                return read;
+            if (dest)
+                dest[i] = value;
+            ++read;
+        }
     }
 
     return read;
@@ -199,7 +320,7 @@ uint32_t ysfx_text_file_t::string(std::string &str)
 
     int ch;
     do {
-        ch = fgetc(m_stream.get());
+        ch = next_char();
         if (ch != EOF && str.size() < ysfx_string_max_length)
             str.push_back((unsigned char)ch);
     } while (ch != EOF && ch != '\n');
@@ -211,29 +332,41 @@ uint32_t ysfx_text_file_t::string(std::string &str)
 ysfx_audio_file_t::ysfx_audio_file_t(NSEEL_VMCTX vm, const ysfx_audio_format_t &fmt, const char *filename)
     : m_vm(vm),
       m_fmt(fmt),
-      m_reader(fmt.open(filename), fmt.close)
+      m_data(ysfx_audio_cache_find(fmt, filename)),
+      m_reader(nullptr, fmt.close)
 {
+    if (!m_data) {
+        m_reader.reset(fmt.open(filename));
+        m_buf.reset(new ysfx_real[buffer_size]);
+    }
 }
 
 int32_t ysfx_audio_file_t::avail()
 {
-    if (!m_reader)
+    if (!is_open())
         return -1;
 
-    uint64_t avail = m_fmt.avail(m_reader.get());
+    uint64_t avail = m_data ? (m_data->samples.size() - m_pos) : m_fmt.avail(m_reader.get());
     return (avail > 0x7fffffff) ? 0x7fffffff : (int32_t)avail;
 }
 
 void ysfx_audio_file_t::rewind()
 {
-    if (!m_reader)
-        return;
+    m_pos = 0;
 
-    m_fmt.rewind(m_reader.get());
+    if (m_reader)
+        m_fmt.rewind(m_reader.get());
 }
 
 bool ysfx_audio_file_t::var(ysfx_real *var)
 {
+    if (m_data) {
+        if (m_pos == m_data->samples.size())
+            return false;
+        *var = m_data->samples[(size_t)m_pos++];
+        return true;
+    }
+
     if (!m_reader)
         return false;
 
@@ -242,21 +375,41 @@ bool ysfx_audio_file_t::var(ysfx_real *var)
 
 uint32_t ysfx_audio_file_t::mem(uint32_t offset, uint32_t length)
 {
-    if (!m_reader)
+    if (!is_open())
         return 0;
 
-    uint32_t numread = 0;
-    ysfx_real *buf = m_buf.get();
     ysfx_eel_ram_writer writer(m_vm, offset);
 
+    if (m_data) {
+        uint64_t avail = m_data->samples.size() - m_pos;
+        if (length > avail)
+            length = (uint32_t)avail;
+
+        // copy the decoded samples, one contiguous span at a time
+        const ysfx_real *src = m_data->samples.data() + m_pos;
+        for (uint32_t left = length; left > 0; ) {
+            uint32_t count = left;
+            EEL_F *dest = writer.write_span(count);
+            if (dest)
+                memcpy(dest, src, count * sizeof(ysfx_real));
+            src += count;
+            left -= count;
+        }
+
+        m_pos += length;
+        return length;
+    }
+
+    uint32_t numread = 0;
+
     while (numread < length) {
+        // decode straight into VM memory, or discard where there is none
         uint32_t n = length - numread;
-        if (n > buffer_size)
-            n = buffer_size;
+        EEL_F *dest = writer.write_span(n);
+        if (!dest)
+            dest = m_buf.get();
 
-        uint32_t m = (uint32_t)m_fmt.read(m_reader.get(), buf, n);
-        for (uint32_t i = 0; i < m; ++i)
-            writer.write_next(buf[i]);
+        uint32_t m = (uint32_t)m_fmt.read(m_reader.get(), dest, n);
 
         numread += m;
         if (m < n)
@@ -274,10 +427,10 @@ uint32_t ysfx_audio_file_t::string(std::string &str)
 
 bool ysfx_audio_file_t::riff(uint32_t &nch, ysfx_real &samplerate)
 {
-    if (!m_reader)
+    if (!is_open())
         return false;
 
-    ysfx_audio_file_info_t info = m_fmt.info(m_reader.get());
+    ysfx_audio_file_info_t info = m_data ? m_data->info : m_fmt.info(m_reader.get());
     nch = info.channels;
     samplerate = info.sample_rate;
     return true;
@@ -289,17 +442,76 @@ ysfx_serializer_t::ysfx_serializer_t(NSEEL_VMCTX vm)
 {
 }
 
-void ysfx_serializer_t::begin(bool write, std::string &buffer)
+void ysfx_serializer_t::begin_read(const uint8_t *data, size_t size)
 {
-    m_write = (int)write;
-    m_buffer = &buffer;
+    m_write = 0;
+    m_input = data;
+    m_input_size = size;
     m_pos = 0;
 }
 
+void ysfx_serializer_t::begin_write()
+{
+    m_write = 1;
+    m_output.reset();
+    m_output_size = 0;
+    m_output_capacity = 0;
+
+    m_coverage.vars.clear();
+    m_coverage.ranges.clear();
+    m_coverage.overflow = false;
+    m_ranges_hash = ysfx::hash_stream{};
+
+    // the state of an effect tends to keep the same size
+    if (m_last_output_size > 0)
+        extend(m_last_output_size);
+    m_output_size = 0;
+}
+
+std::unique_ptr<uint8_t[]> ysfx_serializer_t::take_output(size_t &size)
+{
+    size = m_output_size;
+    m_last_output_size = m_output_size;
+    m_coverage.ranges_hash = m_ranges_hash.digest();
+
+    // do not keep a lot more memory than it needs
+    if (m_output_capacity > 2 * m_output_size + 4096) {
+        std::unique_ptr<uint8_t[]> output{new uint8_t[m_output_size]};
+        memcpy(output.get(), m_output.get(), m_output_size);
+        m_output = std::move(output);
+    }
+
+    m_output_size = 0;
+    m_output_capacity = 0;
+    return std::move(m_output);
+}
+
 void ysfx_serializer_t::end()
 {
     m_write = -1;
-    m_buffer = nullptr;
+    m_input = nullptr;
+    m_input_size = 0;
+    m_output.reset();
+    m_output_size = 0;
+    m_output_capacity = 0;
+}
+
+uint8_t *ysfx_serializer_t::extend(size_t size)
+{
+    size_t newsize = m_output_size + size;
+    if (newsize > m_output_capacity) {
+        size_t capacity = m_output_capacity ? m_output_capacity : 256;
+        while (capacity < newsize)
+            capacity += capacity / 2;
+        uint8_t *output = new uint8_t[capacity];
+        if (m_output_size > 0)
+            memcpy(output, m_output.get(), m_output_size);
+        m_output.reset(output);
+        m_output_capacity = capacity;
+    }
+    uint8_t *data = &m_output[m_output_size];
+    m_output_size = newsize;
+    return data;
 }
 
 int32_t ysfx_serializer_t::avail()
@@ -307,7 +519,7 @@ int32_t ysfx_serializer_t::avail()
     if (m_write)
         return -1;
     else
-        return (m_buffer->size() > m_pos) ? 1 : 0;
+        return (m_input_size > m_pos) ? 1 : 0;
 }
 
 void ysfx_serializer_t::rewind()
@@ -317,18 +529,20 @@ void ysfx_serializer_t::rewind()
 bool ysfx_serializer_t::var(ysfx_real *var)
 {
     if (m_write == 1) {
-        uint8_t buf[4];
-        ysfx::pack_f32le((float)*var, buf);
-        m_buffer->append((char *)buf, 4);
+        ysfx::pack_f32le((float)*var, extend(4));
+        if (m_coverage.vars.size() < max_coverage_entries)
+            m_coverage.vars.push_back(var);
+        else
+            m_coverage.overflow = true;
         return true;
     }
     else if (m_write == 0) {
-        if (m_pos + 4 > m_buffer->size()) {
-            m_pos = m_buffer->size();
+        if (m_pos + 4 > m_input_size) {
+            m_pos = m_input_size;
             *var = 0;
             return false;
         }
-        *var = (EEL_F)ysfx::unpack_f32le((uint8_t *)&(*m_buffer)[m_pos]);
+        *var = (EEL_F)ysfx::unpack_f32le(&m_input[m_pos]);
         m_pos += 4;
         return true;
     }
@@ -338,23 +552,53 @@ bool ysfx_serializer_t::var(ysfx_real *var)
 uint32_t ysfx_serializer_t::mem(uint32_t offset, uint32_t length)
 {
     if (m_write == 1) {
+        std::vector<std::pair<uint32_t, uint32_t>> &ranges = m_coverage.ranges;
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == offset)
+            ranges.back().second += length;
+        else if (ranges.size() < max_coverage_entries)
+            ranges.emplace_back(offset, length);
+        else
+            m_coverage.overflow = true;
+
+        // encode the memory one contiguous span at a time, and hash it in
+        // the same pass
+        uint8_t *dest = extend((size_t)length * 4);
         ysfx_eel_ram_reader reader{m_vm, offset};
-        for (uint32_t i = 0; i < length; ++i) {
-            ysfx_real value = reader.read_next();
-            if (!var(&value))
-                return i;
+        for (uint32_t left = length; left > 0; ) {
+            uint32_t count = left;
+            const EEL_F *src = reader.read_span(count);
+            if (src) {
+                ysfx::pack_f32le_block(src, dest, count);
+                m_ranges_hash.update(src, (size_t)count * sizeof(EEL_F));
+            }
+            else {
+                memset(dest, 0, (size_t)count * 4);
+                m_ranges_hash.update_zeros((size_t)count * sizeof(EEL_F));
+            }
+            dest += (size_t)count * 4;
+            left -= count;
         }
         return length;
     }
     else if (m_write == 0) {
+        size_t avail = (m_input_size - m_pos) / 4;
+        uint32_t numread = (length < avail) ? length : (uint32_t)avail;
+
+        const uint8_t *src = &m_input[m_pos];
         ysfx_eel_ram_writer writer{m_vm, offset};
-        for (uint32_t i = 0; i < length; ++i) {
-            ysfx_real value{};
-            if (!var(&value))
-                return i;
-            writer.write_next(value);
+        for (uint32_t left = numread; left > 0; ) {
+            uint32_t count = left;
+            EEL_F *dest = writer.write_span(count);
+            if (dest)
+                ysfx::unpack_f32le_block(src, dest, count);
+            src += (size_t)count * 4;
+            left -= count;
         }
-        return length;
+
+        m_pos += (size_t)numread * 4;
+        if (numread < length)
+            m_pos = m_input_size;
+        return numread;
     }
     return 0;
 }
@@ -386,9 +630,20 @@ static EEL_F NSEEL_CGEN_CALL ysfx_api_file_open(void *opaque, EEL_F *file_)
     case ysfx_file_type_raw:
         file.reset(new ysfx_raw_file_t(fx->vm.get(), filepath.c_str()));
         break;
-    case ysfx_file_type_audio:
-        file.reset(new ysfx_audio_file_t(fx->vm.get(), *(ysfx_audio_format_t *)fmtobj, filepath.c_str()));
+    case ysfx_file_type_audio: {
+        const ysfx_audio_format_t &fmt = *(ysfx_audio_format_t *)fmtobj;
+        ysfx_audio_file_t *audio = new ysfx_audio_file_t(fx->vm.get(), fmt, filepath.c_str());
+        file.reset(audio);
+        // this one streams, have the file decoded in the background for the
+        // next time, which is likely on a re-@init
+        if (!audio->m_data && fx->source.prefetcher) {
+            ysfx_audio_prefetch_t request;
+            request.fmt = fmt;
+            request.path = std::make_shared<const std::string>(std::move(filepath));
+            ysfx_audio_prefetch(fx->source.prefetcher.get(), &request, 1, false);
+        }
         break;
+    }
     case ysfx_file_type_none:
         file.reset(new ysfx_raw_file_t(fx->vm.get(), filepath.c_str()));
         break;
@@ -414,18 +669,9 @@ static EEL_F NSEEL_CGEN_CALL ysfx_api_file_close(void *opaque, EEL_F *handle_)
         return -1;
 
     ysfx_t *fx = (ysfx_t *)opaque;
-    std::unique_ptr<ysfx::mutex> file_mutex;
-    std::unique_lock<ysfx::mutex> lock;
-    std::unique_lock<ysfx::mutex> list_lock;
-
-    // hold both locks to protect file and list access during removal
-    if (!ysfx_get_file(fx, (uint32_t)handle, lock, &list_lock))
+    if (!ysfx_close_file(fx, (uint32_t)handle))
         return -1;
 
-    // preserve the locked mutex of the object being removed
-    file_mutex = std::move(fx->file.list[(uint32_t)handle]->m_mutex);
-
-    fx->file.list[(uint32_t)handle].reset();
     return 0;
 }
 
@@ -18,6 +18,7 @@
 #pragma once
 #include "ysfx.h"
 #include "ysfx_utils.hpp"
+#include "ysfx_audio_cache.hpp"
 #include "WDL/eel2/ns-eel.h"
 #include "WDL/eel2/ns-eel-int.h"
 #include <vector>
@@ -34,8 +35,6 @@ struct ysfx_file_t {
     virtual bool riff(uint32_t &nch, ysfx_real &samplerate) = 0;
     virtual bool is_text() = 0;
     virtual bool is_in_write_mode() = 0;
-
-    std::unique_ptr<ysfx::mutex> m_mutex{new ysfx::mutex};
 };
 
 using ysfx_file_u = std::unique_ptr<ysfx_file_t>;
@@ -44,6 +43,7 @@ using ysfx_file_u = std::unique_ptr<ysfx_file_t>;
 
 struct ysfx_raw_file_t final : ysfx_file_t {
     ysfx_raw_file_t(NSEEL_VMCTX vm, const char *filename);
+    ~ysfx_raw_file_t() override;
 
     int32_t avail() override;
     void rewind() override;
@@ -54,8 +54,14 @@ struct ysfx_raw_file_t final : ysfx_file_t {
     bool is_text() override { return false; }
     bool is_in_write_mode() override { return false; }
 
+    bool is_open() const { return m_map.data || m_stream; }
+
     NSEEL_VMCTX m_vm = nullptr;
+    // the file is read from memory if it can be mapped, from the stream otherwise
+    ysfx::mapped_file m_map;
     ysfx::FILE_u m_stream;
+    uint64_t m_pos = 0;
+    uint64_t m_size = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -72,9 +78,20 @@ struct ysfx_text_file_t final : ysfx_file_t {
     bool is_text() override { return true; }
     bool is_in_write_mode() override { return false; }
 
+    bool next_token(const char *&first, const char *&last);
+    int next_char();
+    bool fill_input();
+
     NSEEL_VMCTX m_vm = nullptr;
     ysfx::FILE_u m_stream;
     std::string m_buf;
+    // input is read in chunks, and tokens are parsed in place when possible
+    enum { input_size = 65536 };
+    std::unique_ptr<char[]> m_input{new char[input_size]};
+    size_t m_input_pos = 0;
+    size_t m_input_end = 0;
+    // whether a read went past the end, as `feof` would tell
+    bool m_eof = false;
 };
 
 //------------------------------------------------------------------------------
@@ -91,11 +108,16 @@ struct ysfx_audio_file_t final : ysfx_file_t {
     bool is_text() override { return false; }
     bool is_in_write_mode() override { return false; }
 
+    bool is_open() const { return m_data || m_reader; }
+
     NSEEL_VMCTX m_vm = nullptr;
     ysfx_audio_format_t m_fmt{};
+    // the decoded file if it is in the cache already, otherwise a reader
+    ysfx_decoded_audio_p m_data;
+    uint64_t m_pos = 0;
     std::unique_ptr<ysfx_audio_reader_t, void (*)(ysfx_audio_reader_t *)> m_reader;
     enum { buffer_size = 256 };
-    std::unique_ptr<ysfx_real[]> m_buf{new ysfx_real[buffer_size]};
+    std::unique_ptr<ysfx_real[]> m_buf;
 };
 
 //------------------------------------------------------------------------------
@@ -103,9 +125,26 @@ struct ysfx_audio_file_t final : ysfx_file_t {
 struct ysfx_serializer_t final : ysfx_file_t {
     explicit ysfx_serializer_t(NSEEL_VMCTX vm);
 
-    void begin(bool write, std::string &buffer);
+    // read from the data of the caller, which must outlive the serialization
+    void begin_read(const uint8_t *data, size_t size);
+    // write into a new buffer, presized to the last size which was written
+    void begin_write();
+    // take the written buffer, which is allocated with `new[]`
+    std::unique_ptr<uint8_t[]> take_output(size_t &size);
     void end();
 
+    // the variables and memory which the last write has read from
+    struct coverage_t {
+        std::vector<ysfx_real *> vars;
+        // offset and length of memory ranges
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        // hash of the memory of the ranges, as it was written
+        uint64_t ranges_hash = 0;
+        // whether it was too large to record all of it
+        bool overflow = false;
+    };
+    const coverage_t &coverage() const { return m_coverage; }
+
     int32_t avail() override;
     void rewind() override;
     bool var(ysfx_real *var) override;
@@ -115,10 +154,23 @@ struct ysfx_serializer_t final : ysfx_file_t {
     bool is_text() override { return false; }
     bool is_in_write_mode() override { return m_write == 1; }
 
+    // make room for `size` more bytes of output, and return where they go
+    uint8_t *extend(size_t size);
+
     NSEEL_VMCTX m_vm{};
     int m_write = -1;
-    std::string *m_buffer = nullptr;
+    // read mode
+    const uint8_t *m_input = nullptr;
+    size_t m_input_size = 0;
     size_t m_pos = 0;
+    // write mode
+    std::unique_ptr<uint8_t[]> m_output;
+    size_t m_output_size = 0;
+    size_t m_output_capacity = 0;
+    size_t m_last_output_size = 0;
+    enum { max_coverage_entries = 65536 };
+    coverage_t m_coverage;
+    ysfx::hash_stream m_ranges_hash;
 };
 
 using ysfx_serializer_u = std::unique_ptr<ysfx_serializer_t>;
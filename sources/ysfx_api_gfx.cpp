@@ -19,6 +19,7 @@
 #include "ysfx_config.hpp"
 #include "ysfx_api_gfx.hpp"
 #include "ysfx_eel_utils.hpp"
+#include "ysfx_image_cache.hpp"
 #if !defined(YSFX_NO_GFX)
 #   include "lice_stb/lice_stb_loaders.hpp"
 #   define WDL_NO_DEFINE_MINMAX
@@ -276,6 +277,20 @@ bool ysfx_gfx_state_is_dirty(ysfx_gfx_state_t *state)
     return state->lice->m_framebuffer_dirty;
 }
 
+uint32_t ysfx_gfx_state_get_dirty_rects(ysfx_gfx_state_t *state, ysfx_gfx_rect_t *rects, uint32_t max)
+{
+    eel_lice_state *lice = state->lice.get();
+    uint32_t count = (uint32_t)lice->m_dirty_rect_count;
+    for (uint32_t i = 0; i < count && i < max; ++i) {
+        const RECT &r = lice->m_dirty_rects[i];
+        rects[i].x = r.left;
+        rects[i].y = r.top;
+        rects[i].w = r.right - r.left;
+        rects[i].h = r.bottom - r.top;
+    }
+    return count;
+}
+
 void ysfx_gfx_state_set_window_state(ysfx_gfx_state_t *state, bool hasFocus, bool windowVisible, bool mouseOver) {
     state->window_state = static_cast<uint32_t>(1) | static_cast<uint32_t>(hasFocus) << 1 | static_cast<uint32_t>(windowVisible) << 2 | static_cast<uint32_t>(mouseOver) << 3;
 }
@@ -392,6 +407,7 @@ void ysfx_gfx_prepare(ysfx_t *fx)
     eel_lice_state *lice = state->lice.get();
 
     lice->m_framebuffer_dirty = false;
+    lice->ClearDirtyRects();
 
     // set variables `gfx_w` and `gfx_h`
     ysfx_real gfx_w = (ysfx_real)lice->m_framebuffer->getWidth();
@@ -30,6 +30,7 @@ void ysfx_gfx_state_set_show_menu_callback(ysfx_gfx_state_t *state, int (*callba
 void ysfx_gfx_state_set_set_cursor_callback(ysfx_gfx_state_t *state, void (*callback)(void *, int32_t));
 void ysfx_gfx_state_set_get_drop_file_callback(ysfx_gfx_state_t *state, const char *(*callback)(void *, int32_t));
 bool ysfx_gfx_state_is_dirty(ysfx_gfx_state_t *state);
+uint32_t ysfx_gfx_state_get_dirty_rects(ysfx_gfx_state_t *state, ysfx_gfx_rect_t *rects, uint32_t max);
 void ysfx_gfx_state_add_key(ysfx_gfx_state_t *state, uint32_t mods, uint32_t key, bool press);
 void ysfx_gfx_state_update_mouse(ysfx_gfx_state_t *state, uint32_t mods, int xpos, int ypos, uint32_t buttons, int wheel, int hwheel);
 void ysfx_gfx_state_set_window_state(ysfx_gfx_state_t *state, bool hasFocus, bool windowVisible, bool mouseOver);
@@ -51,6 +51,12 @@
 
 #define LICE_FUNCTION_VALID(x) (sizeof(int) > 0)
 
+// The text goes through state which LICE and SWELL share among all instances:
+// the bitmap in which LICE_CachedFont renders the glyphs, and the FreeType
+// library with its cache of font faces. Drawing is otherwise confined to the
+// bitmaps of the instance, so only the text is serialized, not all of @gfx.
+static ysfx::mutex ysfx_gfx_text_mutex;
+
 static eel_lice_state *ysfx_get_lice_context(ysfx_t *fx)
 {
     auto gfx_state = ysfx_gfx_get_context(fx);  /* Returns null if not @gfx thread */
@@ -78,6 +84,7 @@ static void LICE__Destroy(LICE_IBitmap *bm)
 }
 static void LICE__SetFromHFont(LICE_IFont * ifont, HFONT font, int flags)
 {
+  std::lock_guard<ysfx::mutex> lock{ysfx_gfx_text_mutex};
   if (ifont) ifont->SetFromHFont(font,flags);
 }
 static LICE_pixel LICE__SetTextColor(LICE_IFont* ifont, LICE_pixel color)
@@ -91,6 +98,7 @@ static void LICE__SetTextCombineMode(LICE_IFont* ifont, int mode, float alpha)
 }
 static int LICE__DrawText(LICE_IFont* ifont, LICE_IBitmap *bm, const char *str, int strcnt, RECT *rect, UINT dtFlags)
 {
+  std::lock_guard<ysfx::mutex> lock{ysfx_gfx_text_mutex};
   if (ifont) return ifont->DrawText(bm, str, strcnt, rect, dtFlags);
   return 0;
 }
@@ -98,10 +106,12 @@ static int LICE__DrawText(LICE_IFont* ifont, LICE_IBitmap *bm, const char *str,
 
 static LICE_IFont *LICE_CreateFont()
 {
+  std::lock_guard<ysfx::mutex> lock{ysfx_gfx_text_mutex};
   return new LICE_CachedFont();
 }
 static void LICE__DestroyFont(LICE_IFont *bm)
 {
+  std::lock_guard<ysfx::mutex> lock{ysfx_gfx_text_mutex};
   delete bm;
 }
 static bool LICE__resize(LICE_IBitmap *bm, int w, int h)
@@ -125,6 +135,8 @@ public:
   LICE_IBitmap *m_framebuffer, *m_framebuffer_extra;
   int m_framebuffer_dirty;
   WDL_TypedBuf<LICE_IBitmap *> m_gfx_images;
+  // the images loaded from the cache, which wrap its pixels until drawn into
+  std::vector<ysfx_decoded_image_p> m_gfx_images_shared;
   struct gfxFontStruct {
     LICE_IFont *font;
     char last_fontname[128];
@@ -157,17 +169,59 @@ public:
     return NULL;
   };
 
+  // get the image as the destination of drawing, a shared one is copied first
+  LICE_IBitmap *GetImageForWrite(EEL_F idx, const char *callername)
+  {
+    if (idx>=0.0 && idx<(EEL_F)m_gfx_images_shared.size() && m_gfx_images_shared[(int)idx]) UnshareImage((int)idx);
+    return GetImageForIndex(idx,callername);
+  }
+  void UnshareImage(int idx);
+  // publish the size of the images which belong to the effect, for the
+  // memory statistics; the framebuffer belongs to the host, and the shared
+  // images to the cache
+  void UpdateImageMemory();
+
+  // the areas of the framebuffer drawn since the last frame, as a few
+  // rectangles which absorb the new ones when they run out
+  enum { MAX_DIRTY_RECTS = 8 };
+  RECT m_dirty_rects[MAX_DIRTY_RECTS];
+  int m_dirty_rect_count;
+
+  void AddDirtyRect(int x1, int y1, int x2, int y2);
+  void SetTextDirty(LICE_IBitmap *dest, const RECT &drawn);
+  void ClearDirtyRects() { m_dirty_rect_count=0; }
+
   void SetImageDirty(LICE_IBitmap *bm)
   {
-    if (bm == m_framebuffer && !m_framebuffer_dirty)
+    SetImageDirty(bm,-0x10000000,-0x10000000,0x10000000,0x10000000);
+  }
+
+  // the area is [x1,x2[ x [y1,y2[, grown by a pixel to cover antialiasing;
+  // an empty area only clears the framebuffer if it's the first drawing
+  void SetImageDirty(LICE_IBitmap *bm, double x1, double y1, double x2, double y2)
+  {
+    if (bm != m_framebuffer) return;
+    if (!m_framebuffer_dirty)
     {
       if (m_gfx_clear && *m_gfx_clear > -1.0)
       {
         const int a=(int)*m_gfx_clear;
         if (LICE_FUNCTION_VALID(LICE_Clear)) LICE_Clear(m_framebuffer,LICE_RGBA((a&0xff),((a>>8)&0xff),((a>>16)&0xff),0));
+        AddDirtyRect(-0x10000000,-0x10000000,0x10000000,0x10000000);
       }
       m_framebuffer_dirty=1;
     }
+    if (x1 > x2) { double t=x1; x1=x2; x2=t; }
+    if (y1 > y2) { double t=y1; y1=y2; y2=t; }
+    if (x1 == x2 || y1 == y2) return;
+    AddDirtyRect(DirtyCoord(x1,false)-1,DirtyCoord(y1,false)-1,DirtyCoord(x2,true)+1,DirtyCoord(y2,true)+1);
+  }
+  static int DirtyCoord(double v, bool upper)
+  {
+    // out of range or NaN extends to the whole image
+    const double lim=(double)0x10000000;
+    if (!(v > -lim && v < lim)) return upper ? 0x10000000 : -0x10000000;
+    return (int)(upper ? ceil(v) : floor(v));
   }
 
   // R, G, B, A, w, h, x, y, mode(1=add,0=copy)
@@ -221,8 +275,10 @@ eel_lice_state::eel_lice_state(NSEEL_VMCTX vm, void *ctx, int image_slots, int f
 
   m_gfx_images.Resize(image_slots);
   memset(m_gfx_images.Get(),0,m_gfx_images.GetSize()*sizeof(m_gfx_images.Get()[0]));
+  m_gfx_images_shared.resize(image_slots);
   m_framebuffer=m_framebuffer_extra=0;
   m_framebuffer_dirty=0;
+  m_dirty_rect_count=0;
 
   m_gfx_r = NSEEL_VM_regvar(vm,"gfx_r");
   m_gfx_g = NSEEL_VM_regvar(vm,"gfx_g");
@@ -250,6 +306,7 @@ eel_lice_state::eel_lice_state(NSEEL_VMCTX vm, void *ctx, int image_slots, int f
 }
 eel_lice_state::~eel_lice_state()
 {
+  ((ysfx_t *)m_user_ctx)->gfx.image_bytes.store(0,std::memory_order_relaxed);
   if (LICE_FUNCTION_VALID(LICE__Destroy)) 
   {
     LICE__Destroy(m_framebuffer_extra);
@@ -270,6 +327,83 @@ eel_lice_state::~eel_lice_state()
   }
 }
 
+void eel_lice_state::UnshareImage(int idx)
+{
+  ysfx_decoded_image_p shared;
+  shared.swap(m_gfx_images_shared[idx]);
+
+  LICE_IBitmap *src=m_gfx_images.Get()[idx];
+  LICE_IBitmap *bm=__LICE_CreateBitmap(0,0,0);
+  if (bm && src) LICE_Copy(bm,src);
+  LICE__Destroy(src);
+  m_gfx_images.Get()[idx]=bm;
+  UpdateImageMemory();
+}
+
+void eel_lice_state::UpdateImageMemory()
+{
+  uint64_t total=0;
+  int x;
+  for (x=0;x<m_gfx_images.GetSize();x++)
+  {
+    LICE_IBitmap *bm=m_gfx_images.Get()[x];
+    if (bm && !m_gfx_images_shared[x])
+      total += (uint64_t)LICE__GetWidth(bm) * (uint64_t)LICE__GetHeight(bm) * sizeof(LICE_pixel);
+  }
+  ((ysfx_t *)m_user_ctx)->gfx.image_bytes.store(total,std::memory_order_relaxed);
+}
+
+void eel_lice_state::AddDirtyRect(int x1, int y1, int x2, int y2)
+{
+  if (!m_framebuffer) return;
+  const int fbw=LICE__GetWidth(m_framebuffer), fbh=LICE__GetHeight(m_framebuffer);
+  RECT r={wdl_max(x1,0),wdl_max(y1,0),wdl_min(x2,fbw),wdl_min(y2,fbh)};
+  if (r.left >= r.right || r.top >= r.bottom) return;
+
+  int x;
+  for (x=0;x<m_dirty_rect_count;x++)
+  {
+    const RECT &o=m_dirty_rects[x];
+    if (r.left >= o.left && r.top >= o.top && r.right <= o.right && r.bottom <= o.bottom) return;
+  }
+
+  // merge with every rectangle it overlaps or touches, until none remain
+  for (;;)
+  {
+    for (x=0;x<m_dirty_rect_count;x++)
+    {
+      const RECT &o=m_dirty_rects[x];
+      if (r.left <= o.right && o.left <= r.right && r.top <= o.bottom && o.top <= r.bottom) break;
+    }
+    if (x == m_dirty_rect_count) break;
+    const RECT o=m_dirty_rects[x];
+    r.left=wdl_min(r.left,o.left); r.top=wdl_min(r.top,o.top);
+    r.right=wdl_max(r.right,o.right); r.bottom=wdl_max(r.bottom,o.bottom);
+    m_dirty_rects[x]=m_dirty_rects[--m_dirty_rect_count];
+  }
+
+  if (m_dirty_rect_count < MAX_DIRTY_RECTS)
+  {
+    m_dirty_rects[m_dirty_rect_count++]=r;
+    return;
+  }
+
+  // out of rectangles, grow the one which gains the least area
+  int best=0;
+  double bestgain=0.0;
+  for (x=0;x<m_dirty_rect_count;x++)
+  {
+    const RECT &o=m_dirty_rects[x];
+    const double area=(double)(o.right-o.left)*(o.bottom-o.top);
+    const double merged=(double)(wdl_max(r.right,o.right)-wdl_min(r.left,o.left))*(wdl_max(r.bottom,o.bottom)-wdl_min(r.top,o.top));
+    if (!x || merged-area < bestgain) { best=x; bestgain=merged-area; }
+  }
+  const RECT o=m_dirty_rects[best];
+  m_dirty_rect_count--;
+  m_dirty_rects[best]=m_dirty_rects[m_dirty_rect_count];
+  AddDirtyRect(wdl_min(r.left,o.left),wdl_min(r.top,o.top),wdl_max(r.right,o.right),wdl_max(r.bottom,o.bottom));
+}
+
 int eel_lice_state::getCurMode()
 {
   const int gmode = (int) (*m_gfx_mode);
@@ -616,7 +750,7 @@ static EEL_F NSEEL_CGEN_CALL ysfx_api_gfx_getsyscol(void* ctxe, INT_PTR np, EEL_
 
 void eel_lice_state::gfx_lineto(EEL_F xpos, EEL_F ypos, EEL_F aaflag)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_lineto");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_lineto");
   if (!dest) return;
 
   int x1=(int)floor(xpos),y1=(int)floor(ypos),x2=(int)floor(*m_gfx_x), y2=(int)floor(*m_gfx_y);
@@ -624,7 +758,7 @@ void eel_lice_state::gfx_lineto(EEL_F xpos, EEL_F ypos, EEL_F aaflag)
       LICE_FUNCTION_VALID(LICE_ClipLine) && 
       LICE_ClipLine(&x1,&y1,&x2,&y2,0,0,LICE__GetWidth(dest),LICE__GetHeight(dest))) 
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,x1,y1,x2+1,y2+1);
     LICE_Line(dest,x1,y1,x2,y2,getCurColor(),(float) *m_gfx_a,getCurMode(),aaflag > 0.5);
   }
   *m_gfx_x = xpos;
@@ -634,12 +768,12 @@ void eel_lice_state::gfx_lineto(EEL_F xpos, EEL_F ypos, EEL_F aaflag)
 
 void eel_lice_state::gfx_circle(float x, float y, float r, bool fill, bool aaflag)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_circle");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_circle");
   if (!dest) return;
 
   if (LICE_FUNCTION_VALID(LICE_Circle) && LICE_FUNCTION_VALID(LICE_FillCircle))
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,x-r,y-r,x+r+1,y+r+1);
     if(fill)
       LICE_FillCircle(dest, x, y, r, getCurColor(), (float) *m_gfx_a, getCurMode(), aaflag);
     else
@@ -649,11 +783,17 @@ void eel_lice_state::gfx_circle(float x, float y, float r, bool fill, bool aafla
 
 void eel_lice_state::gfx_triangle(EEL_F** parms, int np)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest, "gfx_triangle");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest, "gfx_triangle");
   if (np >= 6)
   {
     np &= ~1;
-    SetImageDirty(dest);
+    double x1=parms[0][0],y1=parms[1][0],x2=x1,y2=y1;
+    for (int i=2; i < np; i+=2)
+    {
+      x1=wdl_min(x1,parms[i][0]); x2=wdl_max(x2,parms[i][0]);
+      y1=wdl_min(y1,parms[i+1][0]); y2=wdl_max(y2,parms[i+1][0]);
+    }
+    SetImageDirty(dest,x1,y1,x2+1,y2+1);
     if (np == 6)
     {        
       if (!LICE_FUNCTION_VALID(LICE_FillTriangle)) return;
@@ -682,7 +822,7 @@ void eel_lice_state::gfx_triangle(EEL_F** parms, int np)
 
 void eel_lice_state::gfx_rectto(EEL_F xpos, EEL_F ypos)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_rectto");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_rectto");
   if (!dest) return;
 
   EEL_F x1=xpos,y1=ypos,x2=*m_gfx_x, y2=*m_gfx_y;
@@ -691,7 +831,7 @@ void eel_lice_state::gfx_rectto(EEL_F xpos, EEL_F ypos)
 
   if (LICE_FUNCTION_VALID(LICE_FillRect) && x2-x1 > 0.5 && y2-y1 > 0.5)
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,x1,y1,x2,y2);
     LICE_FillRect(dest,(int)x1,(int)y1,(int)(x2-x1),(int)(y2-y1),getCurColor(),(float)*m_gfx_a,getCurMode());
   }
   *m_gfx_x = xpos;
@@ -701,7 +841,7 @@ void eel_lice_state::gfx_rectto(EEL_F xpos, EEL_F ypos)
 
 void eel_lice_state::gfx_line(int np, EEL_F **parms)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_line");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_line");
   if (!dest) return;
 
   int x1=(int)floor(parms[0][0]),y1=(int)floor(parms[1][0]),x2=(int)floor(parms[2][0]), y2=(int)floor(parms[3][0]);
@@ -710,14 +850,14 @@ void eel_lice_state::gfx_line(int np, EEL_F **parms)
       LICE_FUNCTION_VALID(LICE_Line) && 
       LICE_FUNCTION_VALID(LICE_ClipLine) && LICE_ClipLine(&x1,&y1,&x2,&y2,0,0,LICE__GetWidth(dest),LICE__GetHeight(dest))) 
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,x1,y1,x2+1,y2+1);
     LICE_Line(dest,x1,y1,x2,y2,getCurColor(),(float)*m_gfx_a,getCurMode(),np< 5 || parms[4][0] > 0.5);
   } 
 }
 
 void eel_lice_state::gfx_rect(int np, EEL_F **parms)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_rect");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_rect");
   if (!dest) return;
 
   int x1=(int)floor(parms[0][0]),y1=(int)floor(parms[1][0]),w=(int)floor(parms[2][0]),h=(int)floor(parms[3][0]);  
@@ -725,7 +865,7 @@ void eel_lice_state::gfx_rect(int np, EEL_F **parms)
 
   if (LICE_FUNCTION_VALID(LICE_FillRect) && LICE_FUNCTION_VALID(LICE_DrawRect) && w>0 && h>0)
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,x1,y1,(double)x1+w,(double)y1+h);
     if (filled) LICE_FillRect(dest,x1,y1,w,h,getCurColor(),(float)*m_gfx_a,getCurMode());
     else LICE_DrawRect(dest, x1, y1, w-1, h-1, getCurColor(), (float)*m_gfx_a, getCurMode());
   }
@@ -733,42 +873,43 @@ void eel_lice_state::gfx_rect(int np, EEL_F **parms)
 
 void eel_lice_state::gfx_roundrect(int np, EEL_F **parms)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_roundrect");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_roundrect");
   if (!dest) return;
 
   const bool aa = np <= 5 || parms[5][0]>0.5;
 
   if (LICE_FUNCTION_VALID(LICE_RoundRect) && parms[2][0]>0 && parms[3][0]>0)
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,parms[0][0],parms[1][0],parms[0][0]+parms[2][0]+1,parms[1][0]+parms[3][0]+1);
     LICE_RoundRect(dest, (float)parms[0][0], (float)parms[1][0], (float)parms[2][0], (float)parms[3][0], (int)parms[4][0], getCurColor(), (float)*m_gfx_a, getCurMode(), aa);
   }
 }
 
 void eel_lice_state::gfx_arc(int np, EEL_F **parms)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_arc");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_arc");
   if (!dest) return;
 
   const bool aa = np <= 5 || parms[5][0]>0.5;
 
   if (LICE_FUNCTION_VALID(LICE_Arc))
   {
-    SetImageDirty(dest);
+    const EEL_F r=fabs(parms[2][0]);
+    SetImageDirty(dest,parms[0][0]-r,parms[1][0]-r,parms[0][0]+r+1,parms[1][0]+r+1);
     LICE_Arc(dest, (float)parms[0][0], (float)parms[1][0], (float)parms[2][0], (float)parms[3][0], (float)parms[4][0], getCurColor(), (float)*m_gfx_a, getCurMode(), aa);
   }
 }
 
 void eel_lice_state::gfx_grad_or_muladd_rect(int whichmode, int np, EEL_F **parms)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,whichmode==0?"gfx_gradrect":"gfx_muladdrect");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,whichmode==0?"gfx_gradrect":"gfx_muladdrect");
   if (!dest) return;
 
   const int x1=(int)floor(parms[0][0]),y1=(int)floor(parms[1][0]),w=(int)floor(parms[2][0]), h=(int)floor(parms[3][0]);
 
   if (w>0 && h>0)
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,x1,y1,(double)x1+w,(double)y1+h);
     if (whichmode==0 && LICE_FUNCTION_VALID(LICE_GradRect) && np > 7)
     {
       LICE_GradRect(dest,x1,y1,w,h,(float)parms[4][0],(float)parms[5][0],(float)parms[6][0],(float)parms[7][0],
@@ -789,7 +930,7 @@ void eel_lice_state::gfx_grad_or_muladd_rect(int whichmode, int np, EEL_F **parm
 
 void eel_lice_state::gfx_setpixel(EEL_F r, EEL_F g, EEL_F b)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_setpixel");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_setpixel");
   if (!dest) return;
 
   int red=(int) (r*255.0);
@@ -801,7 +942,7 @@ void eel_lice_state::gfx_setpixel(EEL_F r, EEL_F g, EEL_F b)
 
   if (LICE_FUNCTION_VALID(LICE_PutPixel)) 
   {
-    SetImageDirty(dest);
+    SetImageDirty(dest,*m_gfx_x,*m_gfx_y,*m_gfx_x+1,*m_gfx_y+1);
     LICE_PutPixel(dest,(int)*m_gfx_x, (int)*m_gfx_y,LICE_RGBA(red,green,blue,255), (float)*m_gfx_a,getCurMode());
   }
 }
@@ -834,11 +975,16 @@ EEL_F eel_lice_state::gfx_loadimg(void *opaque, int img, EEL_F loadFrom)
 
     if (ok && fs.GetLength())
     {
-      LICE_IBitmap *bm = LICE_LoadImage(fs.Get(),NULL,false);
+      // other effects likely display the same image, share it until drawn into
+      LICE_IBitmap *bm = NULL;
+      ysfx_decoded_image_p shared = ysfx_image_cache_get(fs.Get(),&bm);
+      if (shared) bm = new LICE_WrapperBitmap((LICE_pixel *)shared->bits,shared->width,shared->height,shared->span,false);
       if (bm)
       {
         LICE__Destroy(m_gfx_images.Get()[img]);
         m_gfx_images.Get()[img]=bm;
+        m_gfx_images_shared[img]=std::move(shared);
+        UpdateImageMemory();
         return img;
       }
     }
@@ -864,6 +1010,13 @@ EEL_F eel_lice_state::gfx_setimgdim(int img, EEL_F *w, EEL_F *h)
   if (img >= 0 && img < m_gfx_images.GetSize()) 
   {
     bm=m_gfx_images.Get()[img];  
+    if (bm && m_gfx_images_shared[img] && (use_w != LICE__GetWidth(bm) || use_h != LICE__GetHeight(bm)))
+    {
+      // the shared image cannot resize, replace it with a new one
+      m_gfx_images_shared[img].reset();
+      LICE__Destroy(bm);
+      m_gfx_images.Get()[img] = bm = NULL;
+    }
     if (!bm) 
     {
       m_gfx_images.Get()[img] = bm = __LICE_CreateBitmap(1,use_w,use_h);
@@ -873,6 +1026,7 @@ EEL_F eel_lice_state::gfx_setimgdim(int img, EEL_F *w, EEL_F *h)
     {
       rv=LICE__resize(bm,use_w,use_h);
     }
+    UpdateImageMemory();
   }
 
   return rv?1.0:0.0;
@@ -880,21 +1034,20 @@ EEL_F eel_lice_state::gfx_setimgdim(int img, EEL_F *w, EEL_F *h)
 
 void eel_lice_state::gfx_blurto(EEL_F x, EEL_F y)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_blurto");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_blurto");
   if (!dest
 #ifdef DYNAMIC_LICE
     ||!LICE_Blur
 #endif
     ) return;
 
-  SetImageDirty(dest);
-  
   int srcx = (int)x;
   int srcy = (int)y;
   int srcw=(int) (*m_gfx_x-x);
   int srch=(int) (*m_gfx_y-y);
   if (srch < 0) { srch=-srch; srcy = (int)*m_gfx_y; }
   if (srcw < 0) { srcw=-srcw; srcx = (int)*m_gfx_x; }
+  SetImageDirty(dest,srcx,srcy,(double)srcx+srcw,(double)srcy+srch);
   LICE_Blur(dest,dest,srcx,srcy,srcx,srcy,srcw,srch);
   *m_gfx_x = x;
   *m_gfx_y = y;
@@ -911,7 +1064,7 @@ static bool CoordsSrcDestOverlap(EEL_F *coords)
 
 void eel_lice_state::gfx_transformblit(EEL_F **parms, int div_w, int div_h, EEL_F *tab)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_transformblit");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_transformblit");
 
   if (!dest
 #ifdef DYNAMIC_LICE
@@ -927,7 +1080,7 @@ void eel_lice_state::gfx_transformblit(EEL_F **parms, int div_w, int div_h, EEL_
  
   const bool isFromFB = bm==m_framebuffer;
 
-  SetImageDirty(dest);
+  SetImageDirty(dest,floor(parms[1][0]),floor(parms[2][0]),floor(parms[1][0])+floor(parms[3][0]),floor(parms[2][0])+floor(parms[4][0]));
 
   if (bm == dest)
   {
@@ -1009,6 +1162,7 @@ EEL_F eel_lice_state::gfx_setfont(void *opaque, int np, EEL_F **parms)
           const int fw = (fontflag&EELFONT_FLAG_BOLD) ? FW_BOLD : FW_NORMAL;
           const bool italic = !!(fontflag&EELFONT_FLAG_ITALIC);
           const bool underline = !!(fontflag&EELFONT_FLAG_UNDERLINE);
+          std::unique_lock<ysfx::mutex> text_lock{ysfx_gfx_text_mutex};
           HFONT hf=NULL;
 #if defined(_WIN32) && !defined(WDL_NO_SUPPORT_UTF8)
           WCHAR wf[256];
@@ -1055,6 +1209,7 @@ EEL_F eel_lice_state::gfx_setfont(void *opaque, int np, EEL_F **parms)
               }
             }
 
+            text_lock.unlock();
             s->use_fonth=wdl_max(tm.tmHeight,1);
             LICE__SetFromHFont(s->font,hf, (fontflag & ~EELFONT_FLAG_MASK) | 512 /*LICE_FONT_FLAG_OWNS_HFONT*/);
           }
@@ -1086,7 +1241,7 @@ EEL_F eel_lice_state::gfx_setfont(void *opaque, int np, EEL_F **parms)
 
 void eel_lice_state::gfx_blitext2(int np, EEL_F **parms, int blitmode)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_blitext2");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_blitext2");
 
   if (!dest
 #ifdef DYNAMIC_LICE
@@ -1120,7 +1275,8 @@ void eel_lice_state::gfx_blitext2(int np, EEL_F **parms, int blitmode)
   coords[7]=np > 8 ? parms[8][0] : coords[3]*sc;
  
   const bool isFromFB = bm == m_framebuffer;
-  SetImageDirty(dest);
+  if (blitmode!=1 && fabs(angle)>0.000000001) SetImageDirty(dest); // the rotation may reach anywhere
+  else SetImageDirty(dest,(int)coords[4],(int)coords[5],(double)(int)coords[4]+(int)coords[6],(double)(int)coords[5]+(int)coords[7]);
  
   if (bm == dest &&
       (blitmode != 0 || np > 1) && // legacy behavior to matech previous gfx_blit(3parm), do not use temp buffer
@@ -1168,7 +1324,7 @@ void eel_lice_state::gfx_blitext2(int np, EEL_F **parms, int blitmode)
 
 void eel_lice_state::gfx_blitext(EEL_F img, EEL_F *coords, EEL_F angle)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_blitext");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_blitext");
 
   if (!dest
 #ifdef DYNAMIC_LICE
@@ -1179,7 +1335,8 @@ void eel_lice_state::gfx_blitext(EEL_F img, EEL_F *coords, EEL_F angle)
   LICE_IBitmap *bm=GetImageForIndex(img,"gfx_blitext:src");
   if (!bm) return;
   
-  SetImageDirty(dest);
+  if (fabs(angle)>0.000000001) SetImageDirty(dest); // the rotation may reach anywhere
+  else SetImageDirty(dest,(int)coords[4],(int)coords[5],(double)(int)coords[4]+(int)coords[6],(double)(int)coords[5]+(int)coords[7]);
   const bool isFromFB = bm == m_framebuffer;
  
   int bmw=LICE__GetWidth(bm);
@@ -1239,8 +1396,9 @@ void eel_lice_state::gfx_getpixel(EEL_F *r, EEL_F *g, EEL_F *b)
 }
 
 
+// drawn receives the area covered by the text, for DT_NOCLIP without alignment
 static int __drawTextWithFont(LICE_IBitmap *dest, const RECT *rect, LICE_IFont *font, const char *buf, int buflen, 
-  int fg, int mode, float alpha, int flags, EEL_F *wantYoutput, EEL_F **measureOnly)
+  int fg, int mode, float alpha, int flags, EEL_F *wantYoutput, EEL_F **measureOnly, RECT *drawn=NULL)
 {
   if (font && LICE_FUNCTION_VALID(LICE__DrawText))
   {
@@ -1261,6 +1419,7 @@ static int __drawTextWithFont(LICE_IBitmap *dest, const RECT *rect, LICE_IFont *
         r.right += tr.left;
         lineh = LICE__DrawText(font,dest,buf,thislen?thislen:1,&tr,DT_SINGLELINE|DT_NOPREFIX|flags);
         if (wantYoutput) *wantYoutput = tr.top;
+        if (r.right > maxx) maxx=r.right;
       }
       else
       {
@@ -1276,6 +1435,13 @@ static int __drawTextWithFont(LICE_IBitmap *dest, const RECT *rect, LICE_IFont *
       measureOnly[0][0] = maxx;
       measureOnly[1][0] = tr.top;
     }
+    else if (drawn)
+    {
+      drawn->left = rect->left;
+      drawn->top = rect->top;
+      drawn->right = maxx;
+      drawn->bottom = tr.top;
+    }
     return r.right;
   }
   else
@@ -1342,11 +1508,27 @@ static int __drawTextWithFont(LICE_IBitmap *dest, const RECT *rect, LICE_IFont *
     else
     {
       if (wantYoutput) *wantYoutput=ypos;
+      if (drawn)
+      {
+        drawn->left = rect->left;
+        drawn->top = rect->top;
+        drawn->right = maxx;
+        drawn->bottom = maxy;
+      }
     }
     return xpos;
   }
 }
 
+// the area is known after drawing, when the frame was already cleared by
+// SetImageDirty(dest,0,0,0,0) before it
+void eel_lice_state::SetTextDirty(LICE_IBitmap *dest, const RECT &drawn)
+{
+  if (drawn.right <= drawn.left || drawn.bottom <= drawn.top) return;
+  // a little extra for the glyphs which overhang, such as italics
+  SetImageDirty(dest,drawn.left,drawn.top,drawn.right+2,drawn.bottom+2);
+}
+
 void eel_lice_state::gfx_drawstr(void *opaque, EEL_F **parms, int nparms, int formatmode)// formatmode=1 for format, 2 for purely measure no format
 {
   int nfmtparms = nparms-1;
@@ -1355,7 +1537,7 @@ void eel_lice_state::gfx_drawstr(void *opaque, EEL_F **parms, int nparms, int fo
                           formatmode==2?"gfx_measurestr":
                           formatmode==3?"gfx_measurechar" : "gfx_drawstr";
 
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,funcname);
+  LICE_IBitmap *dest = formatmode>=2 ? GetImageForIndex(*m_gfx_dest,funcname) : GetImageForWrite(*m_gfx_dest,funcname);
   if (!dest) return;
 
 #ifdef DYNAMIC_LICE
@@ -1400,9 +1582,9 @@ void eel_lice_state::gfx_drawstr(void *opaque, EEL_F **parms, int nparms, int fo
 
   if (s_len)
   {
-    SetImageDirty(dest);
     if (formatmode>=2)
     {
+      SetImageDirty(dest,0,0,0,0); // nothing is drawn, but the frame is cleared as it always was
       if (nfmtparms==2)
       {
         RECT r={0,0,0,0};
@@ -1421,19 +1603,23 @@ void eel_lice_state::gfx_drawstr(void *opaque, EEL_F **parms, int nparms, int fo
         r.right=(int)*parms[2];
         r.bottom=(int)*parms[3];
       }
+      const bool dirtyAfter = (flags & DT_NOCLIP) && !(flags & (DT_CENTER|DT_RIGHT|DT_VCENTER|DT_BOTTOM));
+      if (!(flags & DT_NOCLIP)) SetImageDirty(dest,r.left,r.top,r.right,r.bottom);
+      else if (!dirtyAfter) SetImageDirty(dest);
+      else SetImageDirty(dest,0,0,0,0);
+      RECT drawn={0,0,0,0};
       *m_gfx_x=__drawTextWithFont(dest,&r,GetActiveFont(),s,s_len,
-        getCurColor(),getCurMode(),(float)*m_gfx_a,flags,m_gfx_y,NULL);
+        getCurColor(),getCurMode(),(float)*m_gfx_a,flags,m_gfx_y,NULL,dirtyAfter?&drawn:NULL);
+      SetTextDirty(dest,drawn);
     }
   }
 }
 
 void eel_lice_state::gfx_drawchar(EEL_F ch)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_drawchar");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_drawchar");
   if (!dest) return;
 
-  SetImageDirty(dest);
-
   int a=(int)(ch+0.5);
   if (a == '\r' || a=='\n') a=' ';
 
@@ -1441,20 +1627,21 @@ void eel_lice_state::gfx_drawchar(EEL_F ch)
   const int buflen = WDL_MakeUTFChar(buf, a, sizeof(buf));
 
   RECT r={(int)floor(*m_gfx_x),(int)floor(*m_gfx_y),0,0};
+  RECT drawn={0,0,0,0};
+  SetImageDirty(dest,0,0,0,0);
   *m_gfx_x = __drawTextWithFont(dest,&r,
                          GetActiveFont(),buf,buflen,
-                         getCurColor(),getCurMode(),(float)*m_gfx_a,DT_NOCLIP,NULL,NULL);
+                         getCurColor(),getCurMode(),(float)*m_gfx_a,DT_NOCLIP,NULL,NULL,&drawn);
+  SetTextDirty(dest,drawn);
 
 }
 
 
 void eel_lice_state::gfx_drawnumber(EEL_F n, EEL_F ndigits)
 {
-  LICE_IBitmap *dest = GetImageForIndex(*m_gfx_dest,"gfx_drawnumber");
+  LICE_IBitmap *dest = GetImageForWrite(*m_gfx_dest,"gfx_drawnumber");
   if (!dest) return;
 
-  SetImageDirty(dest);
-
   char buf[512];
   int a=(int)(ndigits+0.5);
   if (a <0)a=0;
@@ -1462,7 +1649,10 @@ void eel_lice_state::gfx_drawnumber(EEL_F n, EEL_F ndigits)
   snprintf(buf,sizeof(buf),"%.*f",a,n);
 
   RECT r={(int)floor(*m_gfx_x),(int)floor(*m_gfx_y),0,0};
+  RECT drawn={0,0,0,0};
+  SetImageDirty(dest,0,0,0,0);
   *m_gfx_x = __drawTextWithFont(dest,&r,
                            GetActiveFont(),buf,(int)strlen(buf),
-                           getCurColor(),getCurMode(),(float)*m_gfx_a,DT_NOCLIP,NULL,NULL);
+                           getCurColor(),getCurMode(),(float)*m_gfx_a,DT_NOCLIP,NULL,NULL,&drawn);
+  SetTextDirty(dest,drawn);
 }
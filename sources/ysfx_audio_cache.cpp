@@ -0,0 +1,214 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_audio_cache.hpp"
+#include "ysfx_file_cache.hpp"
+#include "ysfx_utils.hpp"
+#include <string>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+
+namespace {
+
+ysfx::file_cache<ysfx_decoded_audio_t> &get_cache()
+{
+    static ysfx::file_cache<ysfx_decoded_audio_t> cache{256 * 1024 * 1024};
+    return cache;
+}
+
+std::string make_key(const ysfx_audio_format_t &fmt, const char *path)
+{
+    // the same file may be handled by different formats in different configs
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%p:", (void *)fmt.open);
+    return std::string(prefix) + path;
+}
+
+ysfx_decoded_audio_p decode_file(const ysfx_audio_format_t &fmt, const char *path, uint64_t budget, const std::atomic<bool> *cancel, uint64_t &bytes)
+{
+    std::unique_ptr<ysfx_audio_reader_t, void (*)(ysfx_audio_reader_t *)> reader{fmt.open(path), fmt.close};
+    if (!reader)
+        return nullptr;
+
+    uint64_t count = fmt.avail(reader.get());
+    if (count * sizeof(ysfx_real) > budget)
+        return nullptr;
+
+    std::shared_ptr<ysfx_decoded_audio_t> data{new ysfx_decoded_audio_t};
+    data->info = fmt.info(reader.get());
+    data->samples.resize((size_t)count);
+
+    // decode in large chunks, it is the reader which knows how to do it best
+    //   a background decode is cancelable in between
+    const uint64_t chunk = cancel ? (uint64_t)1 << 20 : count;
+    uint64_t decoded = 0;
+    while (decoded < count) {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return nullptr;
+        uint64_t n = fmt.read(reader.get(), data->samples.data() + decoded, std::min(chunk, count - decoded));
+        if (n == 0)
+            break;
+        decoded += n;
+    }
+    data->samples.resize((size_t)decoded);
+
+    bytes = data->samples.size() * sizeof(ysfx_real);
+    return data;
+}
+
+ysfx_decoded_audio_p get_or_decode(const ysfx_audio_format_t &fmt, const char *path, const std::atomic<bool> *cancel)
+{
+    ysfx::file_stamp stamp;
+    if (!ysfx::get_file_stamp(path, stamp))
+        return nullptr;
+
+    // a file which another thread is decoding is not ready
+    return get_cache().get(make_key(fmt, path), stamp, false, [&](uint64_t budget, uint64_t &bytes) {
+        return decode_file(fmt, path, budget, cancel, bytes);
+    });
+}
+
+} // namespace
+
+ysfx_decoded_audio_p ysfx_audio_cache_find(const ysfx_audio_format_t &fmt, const char *path)
+{
+    ysfx::file_stamp stamp;
+    if (!ysfx::get_file_stamp(path, stamp))
+        return nullptr;
+
+    return get_cache().find(make_key(fmt, path), stamp);
+}
+
+void ysfx_audio_cache_set_budget(uint64_t bytes)
+{
+    get_cache().set_budget(bytes);
+}
+
+//------------------------------------------------------------------------------
+struct ysfx_audio_prefetcher_t {
+    ysfx_audio_prefetcher_t();
+    ~ysfx_audio_prefetcher_t();
+
+    void run();
+
+    enum { max_requests = 16 };
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    // whether a request is in progress, and notification of being idle
+    bool busy = false;
+    std::condition_variable idle;
+    std::vector<ysfx_audio_prefetch_t> pending;
+    // the number of requests at the front of `pending` which were replaced;
+    // they are released by the thread, rather than by the one replacing them
+    size_t superseded = 0;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+ysfx_audio_prefetcher_t::ysfx_audio_prefetcher_t()
+{
+    // reserve such that requests do not allocate, with room for the
+    // superseded ones which the thread has not released yet
+    pending.reserve(2 * max_requests);
+    thread = std::thread([this]() { run(); });
+}
+
+ysfx_audio_prefetcher_t::~ysfx_audio_prefetcher_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop.store(true);
+    }
+    wakeup.notify_one();
+    thread.join();
+}
+
+void ysfx_audio_prefetcher_t::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;) {
+        wakeup.wait(lock, [this]() { return stop.load() || !pending.empty(); });
+        if (stop.load())
+            break;
+
+        // the first file is the most wanted, unless it was superseded
+        ysfx_audio_prefetch_t file = std::move(pending.front());
+        pending.erase(pending.begin());
+        bool wanted = superseded == 0;
+        if (!wanted)
+            --superseded;
+        busy = true;
+
+        lock.unlock();
+        if (wanted)
+            get_or_decode(file.fmt, file.path->c_str(), &stop);
+        file.path.reset();
+        lock.lock();
+
+        busy = false;
+        if (pending.empty())
+            idle.notify_all();
+    }
+}
+
+std::shared_ptr<ysfx_audio_prefetcher_t> ysfx_audio_prefetcher_acquire()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<ysfx_audio_prefetcher_t> current;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<ysfx_audio_prefetcher_t> prefetcher = current.lock();
+    if (!prefetcher) {
+        prefetcher = std::make_shared<ysfx_audio_prefetcher_t>();
+        current = prefetcher;
+    }
+    return prefetcher;
+}
+
+void ysfx_audio_prefetch(ysfx_audio_prefetcher_t *prefetcher, const ysfx_audio_prefetch_t *files, uint32_t count, bool replace)
+{
+    std::unique_lock<std::mutex> lock(prefetcher->mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    // releasing the superseded requests may free their paths, leave it to
+    // the thread of the prefetcher
+    std::vector<ysfx_audio_prefetch_t> &pending = prefetcher->pending;
+    if (replace)
+        prefetcher->superseded = pending.size();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pending.size() - prefetcher->superseded >= ysfx_audio_prefetcher_t::max_requests ||
+            pending.size() == pending.capacity())
+            break;
+        pending.push_back(files[i]);
+    }
+
+    lock.unlock();
+    prefetcher->wakeup.notify_one();
+}
+
+void ysfx_audio_prefetcher_wait_idle(ysfx_audio_prefetcher_t *prefetcher)
+{
+    std::unique_lock<std::mutex> lock(prefetcher->mutex);
+    prefetcher->idle.wait(lock, [prefetcher]() { return !prefetcher->busy && prefetcher->pending.empty(); });
+}
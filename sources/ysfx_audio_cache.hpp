@@ -0,0 +1,71 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Process-wide cache of decoded audio files, see ysfx::file_cache
+//
+// Files are keyed by path and format. An open file keeps its data after
+// eviction.
+
+struct ysfx_decoded_audio_t {
+    ysfx_audio_file_info_t info{};
+    // interleaved samples
+    std::vector<ysfx_real> samples;
+};
+
+using ysfx_decoded_audio_p = std::shared_ptr<const ysfx_decoded_audio_t>;
+
+// get the decoded contents of the file if they are in the cache already
+//   it never decodes, so that it is suitable for the audio thread; the files
+//   get into the cache by being prefetched, see below
+ysfx_decoded_audio_p ysfx_audio_cache_find(const ysfx_audio_format_t &fmt, const char *path);
+
+// change the memory budget, evicting the files which do not fit anymore
+void ysfx_audio_cache_set_budget(uint64_t bytes);
+
+//------------------------------------------------------------------------------
+// Background decoding of the files which are likely to be opened soon, so the
+// DSP code finds them in the cache instead of reading them on its own thread.
+//
+// There is a single prefetcher shared by all users, and its thread exits when
+// the last reference to it is released.
+
+struct ysfx_audio_prefetcher_t;
+
+struct ysfx_audio_prefetch_t {
+    ysfx_audio_format_t fmt{};
+    // shared, such that copying a request does not allocate
+    std::shared_ptr<const std::string> path;
+};
+
+std::shared_ptr<ysfx_audio_prefetcher_t> ysfx_audio_prefetcher_acquire();
+
+// request these files to be decoded in the given order, after the pending
+// ones, or instead of them if `replace` is set
+//   it does not block, allocate nor free, and the request is dropped if the
+//   prefetcher is busy; it is suitable for the audio thread
+void ysfx_audio_prefetch(ysfx_audio_prefetcher_t *prefetcher, const ysfx_audio_prefetch_t *files, uint32_t count, bool replace);
+
+// wait until the prefetcher has no request left, nor one in progress
+//   it is for the tests, which check the effects of prefetching
+void ysfx_audio_prefetcher_wait_idle(ysfx_audio_prefetcher_t *prefetcher);
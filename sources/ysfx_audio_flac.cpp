@@ -42,8 +42,13 @@ using drflac_u = std::unique_ptr<drflac, drflac_u_deleter>;
 ///
 struct ysfx_flac_reader_t {
     drflac_u flac;
+    // decoding area of the library, before conversion to f64
+    //   FLAC is integer up to 32 bits, which f32 would truncate
+    enum { chunk_frames = 8192 };
+    std::unique_ptr<int32_t[]> chunk;
+    // rest of a frame which was partially read
     uint32_t nbuff = 0;
-    std::unique_ptr<float[]> buff;
+    std::unique_ptr<ysfx_real[]> buff;
 };
 
 static bool ysfx_flac_can_handle(const char *path)
@@ -62,7 +67,8 @@ static ysfx_audio_reader_t *ysfx_flac_open(const char *path)
         return nullptr;
     std::unique_ptr<ysfx_flac_reader_t> reader{new ysfx_flac_reader_t};
     reader->flac = std::move(flac);
-    reader->buff.reset(new float[reader->flac->channels]);
+    reader->chunk.reset(new int32_t[ysfx_flac_reader_t::chunk_frames * reader->flac->channels]);
+    reader->buff.reset(new ysfx_real[reader->flac->channels]);
     return (ysfx_audio_reader_t *)reader.release();
 }
 
@@ -94,6 +100,30 @@ static void ysfx_flac_rewind(ysfx_audio_reader_t *reader_)
     reader->nbuff = 0;
 }
 
+static uint64_t ysfx_flac_decode_frames(ysfx_flac_reader_t *reader, ysfx_real *samples, uint64_t frames)
+{
+    drflac *flac = reader->flac.get();
+    uint32_t channels = flac->channels;
+
+    // decode by large chunks, and convert these to f64
+    uint64_t readframes = 0;
+    while (readframes < frames) {
+        uint64_t n = frames - readframes;
+        if (n > ysfx_flac_reader_t::chunk_frames)
+            n = ysfx_flac_reader_t::chunk_frames;
+
+        uint64_t m = drflac_read_pcm_frames_s32(flac, n, reader->chunk.get());
+        ysfx::convert_s32_block(reader->chunk.get(), samples, (size_t)(m * channels), 1.0 / 2147483648.0);
+
+        samples += m * channels;
+        readframes += m;
+        if (m < n)
+            break;
+    }
+
+    return readframes;
+}
+
 static uint64_t ysfx_flac_unload_buffer(ysfx_audio_reader_t *reader_, ysfx_real *samples, uint64_t count)
 {
     ysfx_flac_reader_t *reader = (ysfx_flac_reader_t *)reader_;
@@ -105,7 +135,7 @@ static uint64_t ysfx_flac_unload_buffer(ysfx_audio_reader_t *reader_, ysfx_real
     if (nbuff == 0)
         return 0;
 
-    const float *src = &reader->buff[reader->flac->channels - reader->nbuff];
+    const ysfx_real *src = &reader->buff[reader->flac->channels - reader->nbuff];
     for (uint32_t i = 0; i < nbuff; ++i)
         samples[i] = src[i];
 
@@ -131,12 +161,8 @@ static uint64_t ysfx_flac_read(ysfx_audio_reader_t *reader_, ysfx_real *samples,
     if (count == 0)
         return readtotal;
     else {
-        float *f32buf = (float *)samples;
-        uint64_t readframes = drflac_read_pcm_frames_f32(reader->flac.get(), count / channels, f32buf);
+        uint64_t readframes = ysfx_flac_decode_frames(reader, samples, count / channels);
         uint64_t readsamples = channels * readframes;
-        // f32->f64
-        for (uint64_t i = readsamples; i-- > 0; )
-            samples[i] = f32buf[i];
         samples += readsamples;
         count -= readsamples;
         readtotal += readsamples;
@@ -144,7 +170,7 @@ static uint64_t ysfx_flac_read(ysfx_audio_reader_t *reader_, ysfx_real *samples,
 
     if (count == 0)
         return readtotal;
-    else if (drflac_read_pcm_frames_f32(reader->flac.get(), 1, reader->buff.get()) == 1) {
+    else if (ysfx_flac_decode_frames(reader, reader->buff.get(), 1) == 1) {
         reader->nbuff = channels;
         uint64_t copied = ysfx_flac_unload_buffer(reader_, samples, count);
         samples += copied;
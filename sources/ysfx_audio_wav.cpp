@@ -34,11 +34,27 @@
 #   pragma GCC diagnostic pop
 #endif
 
+enum ysfx_wav_sample_type {
+    // decoded as f32 by the library, float formats and the 8-bit ones, which
+    //   keep the 8-bit scaling of the library
+    ysfx_wav_sample_f32,
+    // decoded as s32 by the library, integer formats which f32 would truncate
+    ysfx_wav_sample_s32,
+    // stored as f64 in the file, read without conversion
+    ysfx_wav_sample_f64,
+};
+
 struct ysfx_wav_reader_t {
     ~ysfx_wav_reader_t() { drwav_uninit(wav.get()); }
     std::unique_ptr<drwav> wav;
+    ysfx_wav_sample_type type = ysfx_wav_sample_f32;
+    // decoding area of the library, before conversion to f64
+    enum { chunk_frames = 8192 };
+    std::unique_ptr<float[]> chunk_f32;
+    std::unique_ptr<int32_t[]> chunk_s32;
+    // rest of a frame which was partially read
     uint32_t nbuff = 0;
-    std::unique_ptr<float[]> buff;
+    std::unique_ptr<ysfx_real[]> buff;
 };
 
 static bool ysfx_wav_can_handle(const char *path)
@@ -58,7 +74,27 @@ static ysfx_audio_reader_t *ysfx_wav_open(const char *path)
         return nullptr;
     std::unique_ptr<ysfx_wav_reader_t> reader{new ysfx_wav_reader_t};
     reader->wav = std::move(wav);
-    reader->buff.reset(new float[reader->wav->channels]);
+
+    uint32_t channels = reader->wav->channels;
+    bool is_float = reader->wav->translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT;
+    uint32_t bits = reader->wav->bitsPerSample;
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (is_float && bits == 64)
+        reader->type = ysfx_wav_sample_f64;
+    else
+#endif
+    if (is_float || bits <= 8)
+        reader->type = ysfx_wav_sample_f32;
+    else
+        reader->type = ysfx_wav_sample_s32;
+
+    if (reader->type == ysfx_wav_sample_f32)
+        reader->chunk_f32.reset(new float[ysfx_wav_reader_t::chunk_frames * channels]);
+    else if (reader->type == ysfx_wav_sample_s32)
+        reader->chunk_s32.reset(new int32_t[ysfx_wav_reader_t::chunk_frames * channels]);
+
+    reader->buff.reset(new ysfx_real[channels]);
     return (ysfx_audio_reader_t *)reader.release();
 }
 
@@ -90,6 +126,40 @@ static void ysfx_wav_rewind(ysfx_audio_reader_t *reader_)
     reader->nbuff = 0;
 }
 
+static uint64_t ysfx_wav_decode_frames(ysfx_wav_reader_t *reader, ysfx_real *samples, uint64_t frames)
+{
+    drwav *wav = reader->wav.get();
+    uint32_t channels = wav->channels;
+
+    if (reader->type == ysfx_wav_sample_f64)
+        return drwav_read_pcm_frames(wav, frames, samples);
+
+    // decode by large chunks, and convert these to f64
+    uint64_t readframes = 0;
+    while (readframes < frames) {
+        uint64_t n = frames - readframes;
+        if (n > ysfx_wav_reader_t::chunk_frames)
+            n = ysfx_wav_reader_t::chunk_frames;
+
+        uint64_t m;
+        if (reader->type == ysfx_wav_sample_f32) {
+            m = drwav_read_pcm_frames_f32(wav, n, reader->chunk_f32.get());
+            ysfx::convert_f32_block(reader->chunk_f32.get(), samples, (size_t)(m * channels));
+        }
+        else {
+            m = drwav_read_pcm_frames_s32(wav, n, reader->chunk_s32.get());
+            ysfx::convert_s32_block(reader->chunk_s32.get(), samples, (size_t)(m * channels), 1.0 / 2147483648.0);
+        }
+
+        samples += m * channels;
+        readframes += m;
+        if (m < n)
+            break;
+    }
+
+    return readframes;
+}
+
 static uint64_t ysfx_wav_unload_buffer(ysfx_audio_reader_t *reader_, ysfx_real *samples, uint64_t count)
 {
     ysfx_wav_reader_t *reader = (ysfx_wav_reader_t *)reader_;
@@ -101,7 +171,7 @@ static uint64_t ysfx_wav_unload_buffer(ysfx_audio_reader_t *reader_, ysfx_real *
     if (nbuff == 0)
         return 0;
 
-    const float *src = &reader->buff[reader->wav->channels - reader->nbuff];
+    const ysfx_real *src = &reader->buff[reader->wav->channels - reader->nbuff];
     for (uint32_t i = 0; i < nbuff; ++i)
         samples[i] = src[i];
 
@@ -127,12 +197,8 @@ static uint64_t ysfx_wav_read(ysfx_audio_reader_t *reader_, ysfx_real *samples,
     if (count == 0)
         return readtotal;
     else {
-        float *f32buf = (float *)samples;
-        uint64_t readframes = drwav_read_pcm_frames_f32(reader->wav.get(), count / channels, f32buf);
+        uint64_t readframes = ysfx_wav_decode_frames(reader, samples, count / channels);
         uint64_t readsamples = channels * readframes;
-        // f32->f64
-        for (uint64_t i = readsamples; i-- > 0; )
-            samples[i] = f32buf[i];
         samples += readsamples;
         count -= readsamples;
         readtotal += readsamples;
@@ -140,7 +206,7 @@ static uint64_t ysfx_wav_read(ysfx_audio_reader_t *reader_, ysfx_real *samples,
 
     if (count == 0)
         return readtotal;
-    else if (drwav_read_pcm_frames_f32(reader->wav.get(), 1, reader->buff.get()) == 1) {
+    else if (ysfx_wav_decode_frames(reader, reader->buff.get(), 1) == 1) {
         reader->nbuff = channels;
         uint64_t copied = ysfx_wav_unload_buffer(reader_, samples, count);
         samples += copied;
@@ -19,6 +19,9 @@
 #include "ysfx_utils.hpp"
 #include "ysfx_audio_wav.hpp"
 #include "ysfx_audio_flac.hpp"
+#include "ysfx_audio_cache.hpp"
+#include "ysfx_image_cache.hpp"
+#include <algorithm>
 #include <cassert>
 
 ysfx_config_t *ysfx_config_new()
@@ -118,6 +121,33 @@ void ysfx_set_user_data(ysfx_config_t *config, intptr_t userdata)
     config->userdata = userdata;
 }
 
+bool ysfx_set_shared_gmem(ysfx_config_t *config, bool shared)
+{
+#if !defined(_WIN32)
+    config->shared_gmem = shared;
+    return true;
+#else
+    (void)config;
+    return !shared;
+#endif
+}
+
+void ysfx_set_max_file_handles(ysfx_config_t *config, uint32_t count)
+{
+    // the serializer takes a handle, and the handle keeps bits for a generation
+    config->max_file_handles = std::max<uint32_t>(2, std::min<uint32_t>(count, 65536));
+}
+
+void ysfx_set_audio_cache_budget(uint64_t bytes)
+{
+    ysfx_audio_cache_set_budget(bytes);
+}
+
+void ysfx_set_image_cache_budget(uint64_t bytes)
+{
+    ysfx_image_cache_set_budget(bytes);
+}
+
 //------------------------------------------------------------------------------
 const char *ysfx_log_level_string(ysfx_log_level level)
 {
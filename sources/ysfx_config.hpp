@@ -28,6 +28,8 @@ struct ysfx_config_s {
     std::vector<ysfx_audio_format_t> audio_formats;
     ysfx_log_reporter_t *log_reporter = nullptr;
     intptr_t userdata = 0;
+    bool shared_gmem = false;
+    uint32_t max_file_handles = 64;
     std::atomic<uint32_t> ref_count{1};
 };
 
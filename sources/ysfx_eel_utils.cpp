@@ -23,23 +23,45 @@ ysfx_eel_ram_reader::ysfx_eel_ram_reader(NSEEL_VMCTX vm, int64_t addr)
 {
 }
 
-EEL_F ysfx_eel_ram_reader::read_next()
+void ysfx_eel_ram_reader::next_block()
 {
-    if (m_block_avail == 0) {
-        m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
-            NSEEL_VM_getramptr_noalloc(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
-        if (m_block)
-            m_addr += m_block_avail;
-        else {
-            m_addr += 1;
-            m_block_avail = 1;
-        }
+    m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
+        NSEEL_VM_getramptr_noalloc(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
+    if (m_block)
+        m_addr += m_block_avail;
+    else if (m_addr >= 0 && m_addr < (int64_t)NSEEL_RAM_BLOCKS * NSEEL_RAM_ITEMSPERBLOCK) {
+        // a block which is not allocated reads as zeros until its end
+        m_block_avail = NSEEL_RAM_ITEMSPERBLOCK - (uint32_t)(m_addr % NSEEL_RAM_ITEMSPERBLOCK);
+        m_addr += m_block_avail;
+    }
+    else {
+        m_addr += 1;
+        m_block_avail = 1;
     }
+}
+
+EEL_F ysfx_eel_ram_reader::read_next()
+{
+    if (m_block_avail == 0)
+        next_block();
     EEL_F value = m_block ? *m_block++ : 0;
     m_block_avail -= 1;
     return value;
 }
 
+const EEL_F *ysfx_eel_ram_reader::read_span(uint32_t &count)
+{
+    if (m_block_avail == 0)
+        next_block();
+    if (count > m_block_avail)
+        count = m_block_avail;
+    const EEL_F *span = m_block;
+    if (m_block)
+        m_block += count;
+    m_block_avail -= count;
+    return span;
+}
+
 //------------------------------------------------------------------------------
 ysfx_eel_ram_writer::ysfx_eel_ram_writer(NSEEL_VMCTX vm, int64_t addr)
     : m_vm(vm),
@@ -64,3 +86,24 @@ bool ysfx_eel_ram_writer::write_next(EEL_F value)
     m_block_avail -= 1;
     return true;
 }
+
+EEL_F *ysfx_eel_ram_writer::write_span(uint32_t &count)
+{
+    if (m_block_avail == 0) {
+        m_block = (m_addr < 0 || m_addr > 0xFFFFFFFFu) ? nullptr :
+            NSEEL_VM_getramptr(m_vm, (uint32_t)m_addr, (int32_t *)&m_block_avail);
+        if (m_block)
+            m_addr += m_block_avail;
+        else {
+            m_addr += 1;
+            m_block_avail = 1;
+        }
+    }
+    if (count > m_block_avail)
+        count = m_block_avail;
+    EEL_F *span = m_block;
+    if (m_block)
+        m_block += count;
+    m_block_avail -= count;
+    return span;
+}
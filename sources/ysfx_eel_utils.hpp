@@ -34,8 +34,13 @@ public:
     ysfx_eel_ram_reader() = default;
     ysfx_eel_ram_reader(NSEEL_VMCTX vm, int64_t addr);
     EEL_F read_next();
+    // advance by up to `count` values within a block, and set `count` to the
+    // length advanced; the return is where to read them, or null for zeros
+    const EEL_F *read_span(uint32_t &count);
 
 private:
+    void next_block();
+
     NSEEL_VMCTX m_vm{};
     int64_t m_addr = 0;
     const EEL_F *m_block = nullptr;
@@ -48,6 +53,9 @@ public:
     ysfx_eel_ram_writer() = default;
     ysfx_eel_ram_writer(NSEEL_VMCTX vm, int64_t addr);
     bool write_next(EEL_F value);
+    // advance by up to `count` values within a block, and set `count` to the
+    // length advanced; the return is where to write them, or null to skip
+    EEL_F *write_span(uint32_t &count);
 
 private:
     NSEEL_VMCTX m_vm{};
@@ -0,0 +1,171 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#pragma once
+#include "ysfx_utils.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+namespace ysfx {
+
+//------------------------------------------------------------------------------
+// A cache of the data decoded from files, for the process-wide caches
+//
+// Entries are keyed by a string which identifies the file, and invalidated
+// when the file stamp changes. The least recently used ones are evicted to
+// keep the cache within its memory budget. The data are immutable and
+// reference counted, so their users keep them after eviction.
+
+template <class T>
+class file_cache {
+public:
+    using data_p = std::shared_ptr<const T>;
+
+    explicit file_cache(uint64_t budget) : m_budget(budget) {}
+
+    // the data of the file if they are in the cache, and the file unchanged
+    data_p find(const std::string &key, const file_stamp &stamp);
+
+    // the data of the file, decoded by `decode(budget, bytes)` if necessary,
+    // which returns them with their size, or null on failure
+    //   if another thread is decoding the file, it waits for it if `wait` is
+    //   set, otherwise it returns null; it returns null also when the budget
+    //   is zero, without decoding
+    template <class Decode>
+    data_p get(const std::string &key, const file_stamp &stamp, bool wait, Decode &&decode);
+
+    // change the memory budget, evicting the files which do not fit anymore
+    void set_budget(uint64_t bytes);
+
+private:
+    struct entry {
+        std::string key;
+        file_stamp stamp;
+        data_p data;
+        uint64_t bytes = 0;
+    };
+
+    void evict_to(uint64_t limit);
+
+    std::mutex m_mutex;
+    // most recently used first
+    std::list<entry> m_entries;
+    std::unordered_map<std::string, typename std::list<entry>::iterator> m_index;
+    // keys of the files being decoded, and notification of their completion
+    std::unordered_set<std::string> m_decoding;
+    std::condition_variable m_decoded;
+    uint64_t m_budget = 0;
+    uint64_t m_total = 0;
+};
+
+//------------------------------------------------------------------------------
+template <class T>
+auto file_cache<T>::find(const std::string &key, const file_stamp &stamp) -> data_p
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end() || it->second->stamp != stamp)
+        return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->data;
+}
+
+template <class T>
+template <class Decode>
+auto file_cache<T>::get(const std::string &key, const file_stamp &stamp, bool wait, Decode &&decode) -> data_p
+{
+    uint64_t budget;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // don't do the same work as another thread
+        if (wait)
+            m_decoded.wait(lock, [&]() { return m_decoding.count(key) == 0; });
+        else if (m_decoding.count(key) != 0)
+            return nullptr;
+
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            if (it->second->stamp == stamp) {
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+                return it->second->data;
+            }
+            // the file has changed
+            m_total -= it->second->bytes;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+
+        budget = m_budget;
+        if (budget == 0)
+            return nullptr;
+
+        m_decoding.insert(key);
+    }
+
+    auto decoding_guard = defer([&]() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_decoding.erase(key);
+        }
+        m_decoded.notify_all();
+    });
+
+    // decode without holding the lock
+    uint64_t bytes = 0;
+    data_p data = decode(budget, bytes);
+    if (!data)
+        return nullptr;
+
+    // data too large for the budget are still good for this caller
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (bytes <= m_budget) {
+        evict_to(m_budget - bytes);
+        m_entries.push_front(entry{key, stamp, data, bytes});
+        m_index[key] = m_entries.begin();
+        m_total += bytes;
+    }
+
+    return data;
+}
+
+template <class T>
+void file_cache<T>::set_budget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+    evict_to(bytes);
+}
+
+template <class T>
+void file_cache<T>::evict_to(uint64_t limit)
+{
+    while (m_total > limit && !m_entries.empty()) {
+        entry &ent = m_entries.back();
+        m_total -= ent.bytes;
+        m_index.erase(ent.key);
+        m_entries.pop_back();
+    }
+}
+
+} // namespace ysfx
@@ -1,81 +1,231 @@
 #pragma once
 #include "ysfx_gmem.hpp"
+#include "ysfx_config.hpp"
+#include "ysfx_utils.hpp"
 #include "WDL/eel2/ns-eel.h"
 #include <unordered_map>
+#include <vector>
+#include <memory>
+#include <atomic>
 #include <mutex>
-
-
-namespace
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#if !defined(_WIN32)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+
+struct ysfx_gmem_context
 {
-    struct gmem_context
+    explicit ysfx_gmem_context(std::string_view name_)
+        : name(name_)
     {
-        ~gmem_context()
+    }
+
+    ~ysfx_gmem_context()
+    {
+#if !defined(_WIN32)
+        if (shared_base)
         {
-            NSEEL_VM_FreeGRAM(&ctx);
+            // The blocks belong to the mapping, only the table is ours.
+            munmap(shared_base, ysfx_gmem_shared_size);
+            close(shared_fd);
+            free(ctx);
+            ctx = nullptr;
         }
 
-        std::size_t refcount = 1;
-        void* ctx = nullptr;
-    };
+        if (snapshot_base)
+        {
+            // Unlink the blocks of the snapshot before NSEEL frees the rest.
+            EEL_F** blocks = (EEL_F**)ctx;
+            for (int i = 0; blocks && i < NSEEL_RAM_BLOCKS; ++i)
+            {
+                char* p = (char*)blocks[i];
+                if (p >= (char*)snapshot_base && p < (char*)snapshot_base + snapshot_size)
+                    blocks[i] = nullptr;
+            }
+            munmap(snapshot_base, snapshot_size);
+        }
+#endif
+        NSEEL_VM_FreeGRAM(&ctx);
+    }
+
+    const std::string name;
+    std::atomic<std::size_t> refcount{1};
+    void* ctx = nullptr;
+    void* shared_base = nullptr;
+    int shared_fd = -1;
+    void* snapshot_base = nullptr;
+    std::size_t snapshot_size = 0;
+};
 
-    std::unordered_map<std::string, std::unique_ptr<gmem_context>> gmem_registry;
+
+namespace
+{
+    // Keys are views of the interned `ysfx_gmem_context::name`.
+    // The registry is only consulted when an instance attaches to a namespace
+    // it did not hold already, and when the last reference to one goes away.
+    std::unordered_map<std::string_view, ysfx_gmem_context*> gmem_registry;
 
     std::mutex gmem_registry_mutex;
 }
 
 
-static void** acquire_gmem(std::string_view name)
+std::string ysfx_gmem_shared_object_name(std::string_view name)
 {
-    std::lock_guard lock(gmem_registry_mutex);
+    // Hashed, to stay within the short name limit of some systems (31 on macOS)
+    uint64_t hash = 14695981039346656037u;
+    for (char c : name)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211u;
+    }
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "/ysfx-gmem-%016llx", (unsigned long long)hash);
+    return buf;
+}
 
-    std::string key(name);
-    auto it = gmem_registry.find(key);
 
-    if (it == gmem_registry.end())
+#if !defined(_WIN32)
+static bool map_shared_gmem(ysfx_gmem_context* gmem, std::string& error)
+{
+    std::string object_name = ysfx_gmem_shared_object_name(gmem->name);
+
+    int fd = shm_open(object_name.c_str(), O_RDWR|O_CREAT, 0600);
+    if (fd == -1)
     {
-        auto [new_it, _] = gmem_registry.emplace(key, std::make_unique<gmem_context>());
+        error = strerror(errno);
+        return false;
+    }
 
-        return &new_it->second->ctx;
+    // The segment is sparse: memory is committed as pages are first touched,
+    // in whichever process, and the contents stay zero-initialized until then.
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 &&
+        ((uint64_t)st.st_size >= ysfx_gmem_shared_size ||
+         ftruncate(fd, (off_t)ysfx_gmem_shared_size) == 0);
+
+    void* base = MAP_FAILED;
+    if (ok)
+        base = mmap(nullptr, ysfx_gmem_shared_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (base == MAP_FAILED)
+    {
+        error = strerror(errno);
+        close(fd);
+        return false;
     }
 
-    ++it->second->refcount;
+    // Prefill the block table which NSEEL otherwise allocates on demand,
+    // every block pointing to its place in the mapping.
+    EEL_F** blocks = (EEL_F**)calloc(NSEEL_RAM_BLOCKS, sizeof(EEL_F*));
+    if (!blocks)
+    {
+        munmap(base, ysfx_gmem_shared_size);
+        close(fd);
+        error = "out of memory";
+        return false;
+    }
+
+    for (int i = 0; i < NSEEL_RAM_BLOCKS; ++i)
+        blocks[i] = (EEL_F*)base + (std::size_t)i * NSEEL_RAM_ITEMSPERBLOCK;
+
+    gmem->shared_base = base;
+    gmem->shared_fd = fd;
+    gmem->ctx = blocks;
+    return true;
+}
+#endif
+
+
+static bool retain_gmem(ysfx_gmem_context* gmem)
+{
+    // Only succeeds if the context is not already on its way out.
+    std::size_t count = gmem->refcount.load(std::memory_order_relaxed);
+    do
+    {
+        if (count == 0)
+            return false;
+    } while (!gmem->refcount.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel));
 
-    return &it->second->ctx;
+    return true;
 }
 
 
-static void release_gmem(std::string_view name)
+static ysfx_gmem_context* acquire_gmem(ysfx_t* fx, std::string_view name)
 {
     std::lock_guard lock(gmem_registry_mutex);
 
-    auto it = gmem_registry.find(std::string(name));
+    auto it = gmem_registry.find(name);
 
-    if (it == gmem_registry.end())
+    if (it != gmem_registry.end())
     {
-        // Double detach somehow? Should probably log this.
-        return;
-    }
+        if (retain_gmem(it->second))
+            return it->second;
 
-    if (--it->second->refcount == 0)
+        // The last holder is releasing it concurrently and owns it now.
+        // Start over with a fresh namespace, same as if we came just after.
         gmem_registry.erase(it);
+    }
+
+    std::unique_ptr<ysfx_gmem_context> gmem{new ysfx_gmem_context(name)};
+
+#if !defined(_WIN32)
+    std::string error;
+    if (fx->config->shared_gmem && !map_shared_gmem(gmem.get(), error))
+        ysfx_logf(*fx->config, ysfx_log_warning, "gmem: cannot share \"%s\" with other processes: %s", gmem->name.c_str(), error.c_str());
+#else
+    (void)fx;
+#endif
+
+    gmem_registry.emplace(gmem->name, gmem.get());
+
+    // From here, the references own the context and the last one deletes it.
+    return gmem.release();
+}
+
+
+static void release_gmem(ysfx_gmem_context* gmem)
+{
+    if (gmem->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    std::unique_ptr<ysfx_gmem_context> owned{gmem};
+
+    {
+        std::lock_guard lock(gmem_registry_mutex);
+
+        auto it = gmem_registry.find(gmem->name);
+
+        if (it != gmem_registry.end() && it->second == gmem)
+            gmem_registry.erase(it);
+    }
 }
 
 
 void ysfx_gmem_detach(ysfx_t* fx)
 {
-    if (fx->gmem_name.empty())
+    ysfx_gmem_context* gmem = fx->gmem;
+
+    if (!gmem)
         return;
 
     NSEEL_VM_SetGRAM(fx->vm.get(), nullptr);
-    release_gmem(fx->gmem_name);
+    fx->gmem = nullptr;
 
-    fx->gmem_name.clear();
+    release_gmem(gmem);
 }
 
 
 void ysfx_gmem_attach(ysfx_t* fx, std::string_view name)
 {
-    if (fx->gmem_name == name)
+    if (fx->gmem && fx->gmem->name == name)
         return;
 
     ysfx_gmem_detach(fx);
@@ -86,30 +236,283 @@ void ysfx_gmem_attach(ysfx_t* fx, std::string_view name)
         return;
     }
 
-    void** ctx = acquire_gmem(name);
-    NSEEL_VM_SetGRAM(fx->vm.get(), ctx);
+    ysfx_gmem_context* gmem = acquire_gmem(fx, name);
+    NSEEL_VM_SetGRAM(fx->vm.get(), &gmem->ctx);
 
-    fx->gmem_name = name;
+    fx->gmem = gmem;
 }
 
-std::string get_gmem_identifier(ysfx_t* fx)
+std::string_view get_gmem_identifier(ysfx_t* fx)
 {
-    return fx->gmem_name;
+    return fx->gmem ? std::string_view(fx->gmem->name) : std::string_view();
 }
 
 void** get_gmem_address(ysfx_t* fx)
 {
+    return fx->gmem ? &fx->gmem->ctx : nullptr;
+}
+
+bool is_gmem_shared(ysfx_t* fx)
+{
+    return fx->gmem && fx->gmem->shared_base;
+}
+
+uint32_t get_gmem_used_blocks(ysfx_t* fx)
+{
+    // A shared mapping has every block in place, but only commits the pages
+    // which were touched, so it would not tell anything.
+    if (!fx->gmem || fx->gmem->shared_base)
+        return 0;
+
+    // The table has a fixed small size, unlike the address space it covers.
+    EEL_F** blocks = (EEL_F**)fx->gmem->ctx;
+    uint32_t count = 0;
+    for (int i = 0; blocks && i < NSEEL_RAM_BLOCKS; ++i)
+        count += blocks[i] ? 1 : 0;
+
+    return count;
+}
+
+bool ysfx_gmem_unlink_shared(std::string_view name)
+{
+#if !defined(_WIN32)
+    return shm_unlink(ysfx_gmem_shared_object_name(name).c_str()) == 0;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+bool ysfx_unlink_shared_gmem(const char* name)
+{
+    return ysfx_gmem_unlink_shared(name);
+}
+
+
+//------------------------------------------------------------------------------
+// Snapshots
+//
+// Layout, in native byte order:
+//   snapshot_header
+//   name               (name_length bytes)
+//   block indices      (block_count x uint32_t)
+//   padding            (up to data_offset, aligned to snapshot_alignment)
+//   block data         (block_count x NSEEL_RAM_ITEMSPERBLOCK x EEL_F)
+// Only the blocks which were allocated in the namespace are stored.
+
+namespace
+{
+    struct snapshot_header
+    {
+        char magic[8];
+        uint32_t format;
+        uint32_t items_per_block;
+        uint64_t version;
+        uint64_t data_offset;
+        uint32_t name_length;
+        uint32_t block_count;
+    };
+
+    const char snapshot_magic[8] = {'Y', 'S', 'F', 'X', 'G', 'M', 'E', 'M'};
+    constexpr uint32_t snapshot_format = 1;
+
+    // Keeps the data mappable on the systems with the largest pages
+    constexpr uint64_t snapshot_alignment = 65536;
+
+    constexpr std::size_t snapshot_block_size = NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+}
+
+
+static bool snapshot_block_wanted(ysfx_gmem_context* gmem, uint32_t index)
+{
+    EEL_F* block = ((EEL_F**)gmem->ctx)[index];
+
+    if (!block)
+        return false;
+
+#if !defined(_WIN32) && defined(SEEK_DATA)
+    // Every block of a shared namespace is in place, but most were never
+    // touched, and reading them would commit their pages. The object is
+    // sparse, so find whether any data was written within this block.
+    if (gmem->shared_base)
+    {
+        off_t start = (off_t)index * (off_t)snapshot_block_size;
+        off_t data = lseek(gmem->shared_fd, start, SEEK_DATA);
+        if (data == -1 && errno == ENXIO)
+            return false;
+        if (data != -1 && data >= start + (off_t)snapshot_block_size)
+            return false;
+    }
+#endif
+
+    // A block of zeros reads the same as an absent one.
+    for (std::size_t i = 0; i < NSEEL_RAM_ITEMSPERBLOCK; ++i)
+    {
+        if (block[i] != 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+bool ysfx_save_gmem_snapshot(ysfx_t* fx, const char* path, uint64_t version)
+{
+    ysfx_gmem_context* gmem = fx->gmem;
+
+    if (!gmem)
+        return false;
+
+    EEL_F** blocks = (EEL_F**)gmem->ctx;
+
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; blocks && i < NSEEL_RAM_BLOCKS; ++i)
+    {
+        if (snapshot_block_wanted(gmem, i))
+            indices.push_back(i);
+    }
+
+    snapshot_header header{};
+    memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.format = snapshot_format;
+    header.items_per_block = NSEEL_RAM_ITEMSPERBLOCK;
+    header.version = version;
+    header.name_length = (uint32_t)gmem->name.size();
+    header.block_count = (uint32_t)indices.size();
+
+    uint64_t table_end = sizeof(header) + header.name_length + indices.size() * sizeof(uint32_t);
+    header.data_offset = (table_end + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+
+    ysfx::FILE_u stream{ysfx::fopen_utf8(path, "wb")};
+    if (!stream)
+        return false;
+
+    std::vector<char> padding((std::size_t)(header.data_offset - table_end));
+
+    bool ok = fwrite(&header, sizeof(header), 1, stream.get()) == 1 &&
+        fwrite(gmem->name.data(), 1, gmem->name.size(), stream.get()) == gmem->name.size() &&
+        fwrite(indices.data(), sizeof(uint32_t), indices.size(), stream.get()) == indices.size() &&
+        fwrite(padding.data(), 1, padding.size(), stream.get()) == padding.size();
+
+    for (std::size_t i = 0; ok && i < indices.size(); ++i)
+        ok = fwrite(blocks[indices[i]], snapshot_block_size, 1, stream.get()) == 1;
+
+    return fflush(stream.get()) == 0 && ok;
+}
+
+
+bool ysfx_load_gmem_snapshot(ysfx_t* fx, const char* path, uint64_t version)
+{
+    ysfx_gmem_context* gmem = fx->gmem;
+
+    if (!gmem || gmem->shared_base)
+        return false;
+
+    ysfx::FILE_u stream{ysfx::fopen_utf8(path, "rb")};
+    if (!stream)
+        return false;
+
+    snapshot_header header{};
+    if (fread(&header, sizeof(header), 1, stream.get()) != 1 ||
+        memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) ||
+        header.format != snapshot_format ||
+        header.items_per_block != NSEEL_RAM_ITEMSPERBLOCK ||
+        header.version != version ||
+        header.name_length != gmem->name.size() ||
+        header.block_count > NSEEL_RAM_BLOCKS)
+    {
+        return false;
+    }
+
+    std::string name(header.name_length, '\0');
+    std::vector<uint32_t> indices(header.block_count);
+    if (fread(&name[0], 1, name.size(), stream.get()) != name.size() || name != gmem->name ||
+        fread(indices.data(), sizeof(uint32_t), indices.size(), stream.get()) != indices.size())
+    {
+        return false;
+    }
+
+    std::vector<bool> seen(NSEEL_RAM_BLOCKS);
+    for (uint32_t index : indices)
+    {
+        if (index >= NSEEL_RAM_BLOCKS || seen[index])
+            return false;
+        seen[index] = true;
+    }
+
+    // The data is aligned just after the table, and must be entirely within
+    // the file: a mapping beyond the end would fault when accessed.
+    uint64_t table_end = sizeof(header) + header.name_length + indices.size() * sizeof(uint32_t);
+    if (header.data_offset < table_end ||
+        header.data_offset % snapshot_alignment != 0 ||
+        header.data_offset - table_end >= snapshot_alignment)
+    {
+        return false;
+    }
+
+    std::size_t data_size = (std::size_t)header.block_count * snapshot_block_size;
+
+    int64_t file_size = -1;
+#if !defined(_WIN32)
+    struct stat st;
+    if (fstat(fileno(stream.get()), &st) == 0)
+        file_size = (int64_t)st.st_size;
+#else
+    if (ysfx::fseek_lfs(stream.get(), 0, SEEK_END) == 0)
+        file_size = ysfx::ftell_lfs(stream.get());
+#endif
+    if (file_size < 0 || (uint64_t)file_size < header.data_offset + data_size)
+        return false;
+
     std::lock_guard lock(gmem_registry_mutex);
-    
-    std::string name = fx->gmem_name;
 
-    if (name.empty())
-        return nullptr;
+    if (gmem->ctx)
+        return false;
+
+    EEL_F** blocks = (EEL_F**)calloc(NSEEL_RAM_BLOCKS, sizeof(EEL_F*));
+    if (!blocks)
+        return false;
 
-    auto it = gmem_registry.find(std::string(name));
+#if !defined(_WIN32)
+    // Warm path: blocks are pages of the file, which are read as touched
+    // and only get copied when written.
+    if (data_size > 0)
+    {
+        void* base = mmap(nullptr, (std::size_t)header.data_offset + data_size,
+                          PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno(stream.get()), 0);
+        if (base != MAP_FAILED)
+        {
+            char* data = (char*)base + header.data_offset;
+            for (std::size_t i = 0; i < indices.size(); ++i)
+                blocks[indices[i]] = (EEL_F*)(data + i * snapshot_block_size);
+
+            gmem->snapshot_base = base;
+            gmem->snapshot_size = (std::size_t)header.data_offset + data_size;
+            gmem->ctx = blocks;
+            return true;
+        }
+    }
+#endif
+
+    // Cold path: read the blocks into memory which NSEEL owns.
+    bool ok = ysfx::fseek_lfs(stream.get(), (int64_t)header.data_offset, SEEK_SET) == 0;
+
+    // the allocator NSEEL frees these with; the global is not ours to set
+    auto alloc = nseel_gmem_calloc ? nseel_gmem_calloc : calloc;
+
+    for (std::size_t i = 0; ok && i < indices.size(); ++i)
+    {
+        EEL_F* block = (EEL_F*)alloc(sizeof(EEL_F), NSEEL_RAM_ITEMSPERBLOCK);
+        blocks[indices[i]] = block;
+        ok = block && fread(block, snapshot_block_size, 1, stream.get()) == 1;
+    }
+
+    if (!ok)
+    {
+        NSEEL_VM_FreeGRAM((void**)&blocks);
+        return false;
+    }
 
-    if (it == gmem_registry.end())
-        return nullptr;
-    else
-        return &it->second->ctx;
+    gmem->ctx = blocks;
+    return true;
 }
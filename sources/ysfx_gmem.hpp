@@ -1,11 +1,37 @@
 #include <string_view>
 #include "ysfx.hpp"
 
+// Shared gmem namespace, interned by name and reference counted.
+struct ysfx_gmem_context;
+
+// Size of the mapping of a namespace which is shared across processes.
+// It spans the entire gmem address space, and gets committed on access.
+constexpr std::size_t ysfx_gmem_shared_size =
+    (std::size_t)NSEEL_RAM_BLOCKS * NSEEL_RAM_ITEMSPERBLOCK * sizeof(EEL_F);
+
 // Attach VM to a named gmem context. Empty name means default NSEEL gmem.
+// With `shared_gmem` in the config, a new context is mapped from the POSIX
+// shared memory object named after the namespace, if possible.
 void ysfx_gmem_attach(ysfx_t* fx, std::string_view name);
 
 // Detach from any currently attached named context.
 void ysfx_gmem_detach(ysfx_t* fx);
 
+// Neither of these lock or allocate; they read the handle held by the instance.
+// The identifier is a view of the name held by the context, valid while the
+// instance remains attached to it.
 void** get_gmem_address(ysfx_t* fx);
-std::string get_gmem_identifier(ysfx_t* fx);
+std::string_view get_gmem_identifier(ysfx_t* fx);
+
+// Whether the attached context is mapped from shared memory.
+bool is_gmem_shared(ysfx_t* fx);
+
+// Number of blocks allocated in the attached context, 0 if it is shared.
+uint32_t get_gmem_used_blocks(ysfx_t* fx);
+
+// Name of the shared memory object which backs a namespace.
+std::string ysfx_gmem_shared_object_name(std::string_view name);
+
+// Remove the shared memory object of a namespace. Processes which have it
+// mapped keep their view, later ones start with a zeroed namespace.
+bool ysfx_gmem_unlink_shared(std::string_view name);
@@ -0,0 +1,103 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx_image_cache.hpp"
+#include "ysfx_file_cache.hpp"
+#include "ysfx_utils.hpp"
+#if !defined(YSFX_NO_GFX)
+#   define WDL_NO_DEFINE_MINMAX
+#   include "WDL/swell/swell.h"
+#   include "WDL/lice/lice.h"
+#endif
+#include <string>
+
+#if !defined(YSFX_NO_GFX)
+ysfx_decoded_image_t::~ysfx_decoded_image_t()
+{
+    delete bitmap;
+}
+
+namespace {
+
+ysfx::file_cache<ysfx_decoded_image_t> &get_cache()
+{
+    static ysfx::file_cache<ysfx_decoded_image_t> cache{128 * 1024 * 1024};
+    return cache;
+}
+
+ysfx_decoded_image_p decode_file(const char *path, LICE_IBitmap **unshared, uint64_t &bytes)
+{
+    LICE_IBitmap *bm = LICE_LoadImage(path, nullptr, false);
+    if (!bm)
+        return nullptr;
+
+    // the image is displayed through a wrapper, which has to be upright;
+    // otherwise the caller keeps it for itself
+    if (bm->isFlipped() || !bm->getBits()) {
+        *unshared = bm;
+        return nullptr;
+    }
+
+    std::shared_ptr<ysfx_decoded_image_t> data{new ysfx_decoded_image_t};
+    data->bitmap = bm;
+    data->width = bm->getWidth();
+    data->height = bm->getHeight();
+    data->span = bm->getRowSpan();
+    data->bits = bm->getBits();
+
+    bytes = (uint64_t)data->span * (uint64_t)data->height * sizeof(uint32_t);
+    return data;
+}
+
+} // namespace
+
+ysfx_decoded_image_p ysfx_image_cache_get(const char *path, LICE_IBitmap **unshared)
+{
+    *unshared = nullptr;
+
+    ysfx::file_stamp stamp;
+    if (!ysfx::get_file_stamp(path, stamp))
+        return nullptr;
+
+    // if another thread is decoding this file, wait for it rather than doing
+    // the same work twice
+    bool decoded = false;
+    ysfx_decoded_image_p data = get_cache().get(path, stamp, true, [&](uint64_t, uint64_t &bytes) {
+        decoded = true;
+        return decode_file(path, unshared, bytes);
+    });
+
+    // the cache is disabled
+    if (!data && !decoded)
+        *unshared = LICE_LoadImage(path, nullptr, false);
+
+    return data;
+}
+
+void ysfx_image_cache_set_budget(uint64_t bytes)
+{
+    get_cache().set_budget(bytes);
+}
+
+#else
+
+void ysfx_image_cache_set_budget(uint64_t bytes)
+{
+    (void)bytes;
+}
+
+#endif // !defined(YSFX_NO_GFX)
@@ -0,0 +1,53 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+#include "ysfx.h"
+#include <memory>
+
+#if !defined(YSFX_NO_GFX)
+class LICE_IBitmap;
+
+//------------------------------------------------------------------------------
+// Process-wide cache of decoded image files, see ysfx::file_cache
+//
+// Files are keyed by path. The effects which display an image keep it after
+// eviction; an effect which draws into one makes its own copy first.
+
+struct ysfx_decoded_image_t {
+    ~ysfx_decoded_image_t();
+    int32_t width = 0;
+    int32_t height = 0;
+    // the distance between rows, in pixels
+    int32_t span = 0;
+    // the pixels; it is not const for the sake of LICE, but never written
+    uint32_t *bits = nullptr;
+    LICE_IBitmap *bitmap = nullptr;
+};
+
+using ysfx_decoded_image_p = std::shared_ptr<const ysfx_decoded_image_t>;
+
+// get the decoded contents of the file, decoding it if necessary
+//   an image which cannot be shared, or any image if the cache is disabled,
+//   is decoded for the caller alone: it returns null, and the caller takes
+//   ownership of the bitmap in `unshared`; both are null if the file is not
+//   an image
+ysfx_decoded_image_p ysfx_image_cache_get(const char *path, LICE_IBitmap **unshared);
+#endif
+
+// change the memory budget, evicting the files which do not fit anymore
+void ysfx_image_cache_set_budget(uint64_t bytes);
@@ -16,24 +16,83 @@
 //
 
 #include "ysfx_midi.hpp"
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 
 void ysfx_midi_reserve(ysfx_midi_buffer_t *midi, uint32_t capacity, bool extensible)
 {
-    std::vector<uint8_t> data;
-    data.reserve(capacity);
-    std::swap(data, midi->data);
+    // reserve for the worst case of each kind, so a non-extensible buffer
+    // never has to reallocate when it's used within capacity
+    size_t max_records = capacity / sizeof(ysfx_midi_packed_t);
+
+    std::vector<ysfx_midi_packed_t> events;
+    events.reserve(max_records);
+    std::swap(events, midi->events);
+
+    std::vector<ysfx_midi_extended_t> extended;
+    extended.reserve(max_records);
+    std::swap(extended, midi->extended);
+
+    std::vector<uint8_t> arena;
+    arena.reserve(capacity);
+    std::swap(arena, midi->arena);
+
+    midi->capacity = capacity;
+    midi->used = 0;
     midi->extensible = extensible;
     ysfx_midi_rewind(midi);
 }
 
 void ysfx_midi_clear(ysfx_midi_buffer_t *midi)
 {
-    midi->data.clear();
+    midi->events.clear();
+    midi->extended.clear();
+    midi->arena.clear();
+    midi->used = 0;
     ysfx_midi_rewind(midi);
 }
 
+static bool ysfx_midi_can_write(const ysfx_midi_buffer_t *midi, size_t size)
+{
+    return midi->extensible || midi->capacity - midi->used >= size;
+}
+
+static void ysfx_midi_push_inline(ysfx_midi_buffer_t *midi, uint32_t bus, uint32_t offset, const uint8_t *data, uint32_t size)
+{
+    assert(size <= ysfx_midi_inline_max_size);
+
+    ysfx_midi_packed_t record;
+    record.offset = offset;
+    record.info = (uint8_t)(bus | (size << ysfx_midi_info_size_shift));
+    record.data[0] = (size > 0) ? data[0] : 0;
+    record.data[1] = (size > 1) ? data[1] : 0;
+    record.data[2] = (size > 2) ? data[2] : 0;
+
+    midi->events.push_back(record);
+    midi->used += sizeof(record);
+}
+
+static void ysfx_midi_push_escaped(ysfx_midi_buffer_t *midi, uint32_t bus, uint32_t offset, size_t start, uint32_t size)
+{
+    uint32_t index = (uint32_t)midi->extended.size();
+
+    ysfx_midi_extended_t ext;
+    ext.start = (uint32_t)start;
+    ext.size = size;
+    midi->extended.push_back(ext);
+
+    ysfx_midi_packed_t record;
+    record.offset = offset;
+    record.info = (uint8_t)(bus | ysfx_midi_info_escape);
+    record.data[0] = (uint8_t)(index & 0xff);
+    record.data[1] = (uint8_t)((index >> 8) & 0xff);
+    record.data[2] = (uint8_t)(index >> 16);
+
+    midi->events.push_back(record);
+    midi->used += sizeof(record) + size;
+}
+
 bool ysfx_midi_push(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *event)
 {
     if (event->size > ysfx_midi_message_max_size)
@@ -41,25 +100,61 @@ bool ysfx_midi_push(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *event)
     if (event->bus >= ysfx_max_midi_buses)
         return false;
 
-    ysfx_midi_header_t header;
+    const uint8_t *data = event->data;
 
-    if (!midi->extensible) {
-        size_t writable = midi->data.capacity() - midi->data.size();
-        if (writable < sizeof(header) + event->size)
+    if (event->size <= ysfx_midi_inline_max_size) {
+        if (!ysfx_midi_can_write(midi, sizeof(ysfx_midi_packed_t)))
             return false;
+        ysfx_midi_push_inline(midi, event->bus, event->offset, data, event->size);
+        return true;
     }
 
-    const uint8_t *data = event->data;
-    const uint8_t *headp = (const uint8_t *)&header;
-    header.bus = event->bus;
-    header.offset = event->offset;
-    header.size = event->size;
+    if (!ysfx_midi_can_write(midi, sizeof(ysfx_midi_packed_t) + event->size))
+        return false;
+    if (midi->extended.size() >= ysfx_midi_extended_max_count)
+        return false;
 
-    midi->data.insert(midi->data.end(), headp, headp + sizeof(header));
-    midi->data.insert(midi->data.end(), data, data + header.size);
+    size_t start = midi->arena.size();
+    midi->arena.insert(midi->arena.end(), data, data + event->size);
+    ysfx_midi_push_escaped(midi, event->bus, event->offset, start, event->size);
     return true;
 }
 
+uint32_t ysfx_midi_push_batch(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *events, uint32_t count)
+{
+    // grow geometrically, as successive batches would otherwise reallocate
+    // the records to an exact size every time
+    std::vector<ysfx_midi_packed_t> &records = midi->events;
+    if (midi->extensible && records.capacity() - records.size() < count)
+        records.reserve(std::max(records.size() + count, 2 * records.capacity()));
+
+    // the room is checked once for the batch, and consumed by each record
+    size_t room = midi->extensible ? ~(size_t)0 : (midi->capacity - midi->used);
+
+    uint32_t pushed = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const ysfx_midi_event_t *event = &events[i];
+        if (event->bus >= ysfx_max_midi_buses)
+            continue;
+
+        if (event->size <= ysfx_midi_inline_max_size) {
+            if (room < sizeof(ysfx_midi_packed_t))
+                continue;
+            ysfx_midi_push_inline(midi, event->bus, event->offset, event->data, event->size);
+            if (!midi->extensible)
+                room -= sizeof(ysfx_midi_packed_t);
+            ++pushed;
+        }
+        else if (ysfx_midi_push(midi, event)) {
+            if (!midi->extensible)
+                room = midi->capacity - midi->used;
+            ++pushed;
+        }
+    }
+
+    return pushed;
+}
+
 void ysfx_midi_rewind(ysfx_midi_buffer_t *midi)
 {
     midi->read_pos = 0;
@@ -67,25 +162,34 @@ void ysfx_midi_rewind(ysfx_midi_buffer_t *midi)
         midi->read_pos_for_bus[i] = 0;
 }
 
-bool ysfx_midi_get_next(ysfx_midi_buffer_t *midi, ysfx_midi_event_t *event)
+void ysfx_midi_unpack(const ysfx_midi_buffer_t *midi, const ysfx_midi_packed_t *record, ysfx_midi_event_t *event)
 {
-    size_t *pos_ptr = &midi->read_pos;
-    size_t pos = *pos_ptr;
+    uint8_t info = record->info;
+    event->bus = info & ysfx_midi_info_bus_mask;
+    event->offset = record->offset;
 
-    size_t avail = midi->data.size() - pos;
-    ysfx_midi_header_t header;
-    if (avail == 0)
-        return false;
+    if (!(info & ysfx_midi_info_escape)) {
+        event->size = (info & ysfx_midi_info_size_mask) >> ysfx_midi_info_size_shift;
+        event->data = record->data;
+    }
+    else {
+        uint32_t index = record->data[0] | (record->data[1] << 8) | (record->data[2] << 16);
+        assert(index < midi->extended.size());
+        const ysfx_midi_extended_t &ext = midi->extended[index];
+        assert(ext.start + ext.size <= midi->arena.size());
+        event->size = ext.size;
+        event->data = &midi->arena[ext.start];
+    }
+}
 
-    assert(avail >= sizeof(header));
-    memcpy(&header, &midi->data[pos], sizeof(header));
-    assert(avail >= sizeof(header) + header.size);
+bool ysfx_midi_get_next(ysfx_midi_buffer_t *midi, ysfx_midi_event_t *event)
+{
+    size_t pos = midi->read_pos;
+    if (pos >= midi->events.size())
+        return false;
 
-    event->bus = header.bus;
-    event->offset = header.offset;
-    event->size = header.size;
-    event->data = &midi->data[pos + sizeof(header)];
-    *pos_ptr = pos + (sizeof(header) + header.size);
+    ysfx_midi_unpack(midi, &midi->events[pos], event);
+    midi->read_pos = pos + 1;
     return true;
 }
 
@@ -96,59 +200,60 @@ bool ysfx_midi_get_next_from_bus(ysfx_midi_buffer_t *midi, uint32_t bus, ysfx_mi
 
     size_t *pos_ptr = &midi->read_pos_for_bus[bus];
     size_t pos = *pos_ptr;
-    size_t avail = midi->data.size() - pos;
-    ysfx_midi_header_t header;
-
-    bool found = false;
-    while (!found && avail > 0) {
-        assert(avail >= sizeof(header));
-        memcpy(&header, &midi->data[pos], sizeof(header));
-        assert(avail >= sizeof(header) + header.size);
-
-        found = header.bus == bus;
-        if (!found) {
-            pos += sizeof(header) + header.size;
-            avail -= sizeof(header) + header.size;
-        }
-    }
+    size_t count = midi->events.size();
+    const ysfx_midi_packed_t *events = midi->events.data();
+
+    while (pos < count && (events[pos].info & ysfx_midi_info_bus_mask) != bus)
+        ++pos;
 
-    if (!found) {
+    if (pos == count) {
         *pos_ptr = pos;
         return false;
     }
 
-    event->bus = header.bus;
-    event->offset = header.offset;
-    event->size = header.size;
-    event->data = &midi->data[pos + sizeof(header)];
-    *pos_ptr = pos + (sizeof(header) + header.size);
+    ysfx_midi_unpack(midi, &events[pos], event);
+    *pos_ptr = pos + 1;
     return true;
 }
 
-bool ysfx_midi_push_begin(ysfx_midi_buffer_t *midi, uint32_t bus, uint32_t offset, ysfx_midi_push_t *mp)
+const ysfx_midi_packed_t *ysfx_midi_get_span(ysfx_midi_buffer_t *midi, size_t *count)
+{
+    size_t pos = midi->read_pos;
+    size_t total = midi->events.size();
+    *count = total - pos;
+    midi->read_pos = total;
+    return midi->events.data() + pos;
+}
+
+uint32_t ysfx_midi_get_batch(ysfx_midi_buffer_t *midi, ysfx_midi_event_t *events, uint32_t count)
 {
-    ysfx_midi_header_t header;
+    size_t pos = midi->read_pos;
+    size_t avail = midi->events.size() - pos;
+    if (count > avail)
+        count = (uint32_t)avail;
+
+    const ysfx_midi_packed_t *records = midi->events.data() + pos;
+    for (uint32_t i = 0; i < count; ++i)
+        ysfx_midi_unpack(midi, &records[i], &events[i]);
+
+    midi->read_pos = pos + count;
+    return count;
+}
 
+bool ysfx_midi_push_begin(ysfx_midi_buffer_t *midi, uint32_t bus, uint32_t offset, ysfx_midi_push_t *mp)
+{
     mp->midi = midi;
-    mp->start = midi->data.size();
+    mp->start = midi->arena.size();
     mp->count = 0;
+    mp->bus = bus;
+    mp->offset = offset;
     mp->eob = false;
 
-    if (!midi->extensible) {
-        size_t writable = midi->data.capacity() - midi->data.size();
-        if (writable < sizeof(header)) {
-            mp->eob = true;
-            return false;
-        }
+    if (bus >= ysfx_max_midi_buses || !ysfx_midi_can_write(midi, sizeof(ysfx_midi_packed_t))) {
+        mp->eob = true;
+        return false;
     }
 
-    header.bus = bus;
-    header.offset = offset;
-    header.size = 0;
-
-    const uint8_t *headp = (const uint8_t *)&header;
-    midi->data.insert(midi->data.end(), headp, headp + sizeof(header));
-
     return true;
 }
 
@@ -164,31 +269,42 @@ bool ysfx_midi_push_data(ysfx_midi_push_t *mp, const uint8_t *data, uint32_t siz
 
     ysfx_midi_buffer_t *midi = mp->midi;
 
-    if (!midi->extensible) {
-        size_t writable = midi->data.capacity() - midi->data.size();
-        if (writable < size) {
-            mp->eob = true;
-            return false;
-        }
+    if (!ysfx_midi_can_write(midi, sizeof(ysfx_midi_packed_t) + mp->count + size)) {
+        mp->eob = true;
+        return false;
     }
 
-    midi->data.insert(midi->data.end(), data, data + size);
+    midi->arena.insert(midi->arena.end(), data, data + size);
     mp->count += size;
     return true;
 }
 
 bool ysfx_midi_push_end(ysfx_midi_push_t *mp)
 {
+    ysfx_midi_buffer_t *midi = mp->midi;
+
+    if (!mp->eob && mp->count > ysfx_midi_inline_max_size &&
+        midi->extended.size() >= ysfx_midi_extended_max_count)
+    {
+        mp->eob = true;
+    }
+
     if (mp->eob) {
-        mp->midi->data.resize(mp->start);
+        midi->arena.resize(mp->start);
         return false;
     }
 
-    ysfx_midi_header_t header;
-    uint8_t *headp = &mp->midi->data[mp->start];
-    memcpy(&header, headp, sizeof(header));
-    header.size = mp->count;
-    memcpy(headp, &header, sizeof(header));
+    if (mp->count <= ysfx_midi_inline_max_size) {
+        // short enough to be inline: move it out of the arena
+        uint8_t data[ysfx_midi_inline_max_size];
+        if (mp->count > 0)
+            memcpy(data, &midi->arena[mp->start], mp->count);
+        midi->arena.resize(mp->start);
+        ysfx_midi_push_inline(midi, mp->bus, mp->offset, data, mp->count);
+    }
+    else
+        ysfx_midi_push_escaped(midi, mp->bus, mp->offset, mp->start, mp->count);
+
     return true;
 }
 
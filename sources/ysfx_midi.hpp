@@ -20,14 +20,38 @@
 #include <vector>
 #include <memory>
 
-struct ysfx_midi_header_t {
-    uint32_t bus;
+// packed event record, 8 bytes
+//    messages of up to 3 bytes are stored inline; longer ones (SysEx, etc)
+//    are escaped, and `data` holds a 24-bit index into the `extended` table
+struct ysfx_midi_packed_t {
     uint32_t offset;
+    uint8_t info;
+    uint8_t data[3];
+};
+
+static_assert(sizeof(ysfx_midi_packed_t) == 8, "the packed MIDI record must be 8 bytes");
+
+enum {
+    ysfx_midi_info_bus_mask = 0x0f,
+    ysfx_midi_info_size_shift = 4,
+    ysfx_midi_info_size_mask = 0x30,
+    ysfx_midi_info_escape = 0x80,
+    ysfx_midi_inline_max_size = 3,
+};
+
+// location of an escaped message within the side arena
+struct ysfx_midi_extended_t {
+    uint32_t start;
     uint32_t size;
 };
 
 struct ysfx_midi_buffer_t {
-    std::vector<uint8_t> data;
+    std::vector<ysfx_midi_packed_t> events;
+    std::vector<ysfx_midi_extended_t> extended;
+    std::vector<uint8_t> arena;
+    // accounting in bytes: 8 per record, plus the arena size of escaped ones
+    size_t capacity = 0;
+    size_t used = 0;
     size_t read_pos = 0;
     size_t read_pos_for_bus[ysfx_max_midi_buses] = {};
     bool extensible = false;
@@ -36,6 +60,7 @@ using ysfx_midi_buffer_u = std::unique_ptr<ysfx_midi_buffer_t>;
 
 enum {
     ysfx_midi_message_max_size = 1 << 24,
+    ysfx_midi_extended_max_count = 1 << 24,
 };
 
 // NOTE: regarding buses,
@@ -50,15 +75,27 @@ enum {
 void ysfx_midi_reserve(ysfx_midi_buffer_t *midi, uint32_t capacity, bool extensible);
 void ysfx_midi_clear(ysfx_midi_buffer_t *midi);
 bool ysfx_midi_push(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *event);
+// push many events at once; the events which can't be pushed are skipped, and returns the number pushed
+uint32_t ysfx_midi_push_batch(ysfx_midi_buffer_t *midi, const ysfx_midi_event_t *events, uint32_t count);
 void ysfx_midi_rewind(ysfx_midi_buffer_t *midi);
 bool ysfx_midi_get_next(ysfx_midi_buffer_t *midi, ysfx_midi_event_t *event);
 bool ysfx_midi_get_next_from_bus(ysfx_midi_buffer_t *midi, uint32_t bus, ysfx_midi_event_t *event);
 
+// get the contiguous span of records not read yet, and mark them all as read
+const ysfx_midi_packed_t *ysfx_midi_get_span(ysfx_midi_buffer_t *midi, size_t *count);
+// decode a packed record; the data pointer remains valid until the buffer is modified
+void ysfx_midi_unpack(const ysfx_midi_buffer_t *midi, const ysfx_midi_packed_t *record, ysfx_midi_event_t *event);
+// read up to `count` events at once; returns the number of events read
+uint32_t ysfx_midi_get_batch(ysfx_midi_buffer_t *midi, ysfx_midi_event_t *events, uint32_t count);
+
 // incremental writer into a midi buffer
+//    the message is accumulated in the arena, and committed at the end
 struct ysfx_midi_push_t {
     ysfx_midi_buffer_t *midi = nullptr;
     size_t start = 0;
     uint32_t count = 0;
+    uint32_t bus = 0;
+    uint32_t offset = 0;
     bool eob = false;
 };
 bool ysfx_midi_push_begin(ysfx_midi_buffer_t *midi, uint32_t bus, uint32_t offset, ysfx_midi_push_t *mp);
@@ -25,9 +25,12 @@
 #include <clocale>
 #include <cstring>
 #include <cassert>
+#include <charconv>
+#include <memory>
 #if !defined(_WIN32)
 #   include <sys/stat.h>
 #   include <sys/types.h>
+#   include <sys/mman.h>
 #   include <unistd.h>
 #   include <dirent.h>
 #   include <fcntl.h>
@@ -35,6 +38,10 @@
 #   include <windows.h>
 #   include <io.h>
 #endif
+#if !defined(EEL_TARGET_PORTABLE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   include <emmintrin.h>
+#   define YSFX_HAVE_SSE2 1
+#endif
 
 namespace ysfx {
 
@@ -69,6 +76,66 @@ int64_t ftell_lfs(FILE *stream)
 #endif
 }
 
+bool map_stream_file(FILE *stream, mapped_file &map)
+{
+    map = mapped_file{};
+
+#if !defined(_WIN32)
+    int fd = fileno(stream);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    if (st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX)
+        return false;
+
+    void *base = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+        return false;
+    posix_madvise(base, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    map.data = (const uint8_t *)base;
+    map.size = (uint64_t)st.st_size;
+    return true;
+#else
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(stream));
+    LARGE_INTEGER size;
+    if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &size))
+        return false;
+    if (size.QuadPart <= 0 || (uint64_t)size.QuadPart > SIZE_MAX)
+        return false;
+
+    HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return false;
+
+    void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    map.data = (const uint8_t *)base;
+    map.size = (uint64_t)size.QuadPart;
+    map.mapping = mapping;
+    return true;
+#endif
+}
+
+void unmap_file(mapped_file &map)
+{
+    if (!map.data)
+        return;
+
+#if !defined(_WIN32)
+    munmap((void *)map.data, (size_t)map.size);
+#else
+    UnmapViewOfFile(map.data);
+    CloseHandle((HANDLE)map.mapping);
+#endif
+
+    map = mapped_file{};
+}
+
 //------------------------------------------------------------------------------
 
 namespace {
@@ -199,6 +266,53 @@ double dot_strtod(const char *text, char **endp)
     return c_strtod(text, endp, c_numeric_locale());
 }
 
+double dot_strtod_n(const char *first, const char *last, const char **endp)
+{
+    // accept the same as strtod, on text which is not null-terminated
+    const char *p = first;
+    while (p != last && ascii_isspace(*p))
+        ++p;
+
+#if defined(__cpp_lib_to_chars)
+    const char *q = p;
+    if (q != last && *q == '+')
+        ++q;
+    const char *digits = (q != last && *q == '-') ? q + 1 : q;
+    bool hex = last - digits >= 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X');
+    bool double_sign = q != p && q != last && *q == '-';
+
+    if (!hex && !double_sign) {
+        double value = 0;
+        std::from_chars_result res = std::from_chars(q, last, value);
+        if (res.ec == std::errc{}) {
+            *endp = res.ptr;
+            return value;
+        }
+        if (res.ec == std::errc::invalid_argument) {
+            *endp = first;
+            return 0;
+        }
+        // out of range, let strtod decide what it becomes
+    }
+#endif
+
+    size_t len = (size_t)(last - p);
+    char stackbuf[64];
+    std::unique_ptr<char[]> heapbuf;
+    char *buf = stackbuf;
+    if (len >= sizeof(stackbuf)) {
+        heapbuf.reset(new char[len + 1]);
+        buf = heapbuf.get();
+    }
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+
+    char *bufend = buf;
+    double value = dot_strtod(buf, &bufend);
+    *endp = (bufend != buf) ? p + (bufend - buf) : first;
+    return value;
+}
+
 bool ascii_isspace(char c)
 {
     switch (c) {
@@ -344,6 +458,151 @@ float unpack_f32le(const uint8_t data[4])
     return value;
 }
 
+void pack_f32le_block(const double *src, uint8_t *data, size_t count)
+{
+    size_t i = 0;
+
+#if defined(YSFX_HAVE_SSE2)
+    // x86 is little-endian, so the floats store as data directly
+    for (; i + 4 <= count; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+        _mm_storeu_ps((float *)(data + 4 * i), _mm_movelh_ps(lo, hi));
+    }
+#endif
+
+    for (; i < count; ++i)
+        pack_f32le((float)src[i], data + 4 * i);
+}
+
+void unpack_f32le_block(const uint8_t *data, double *dest, size_t count)
+{
+    size_t i = 0;
+
+#if defined(YSFX_HAVE_SSE2)
+    // x86 is little-endian, so the data loads as floats directly
+    for (; i + 4 <= count; i += 4) {
+        __m128 f = _mm_loadu_ps((const float *)(data + 4 * i));
+        _mm_storeu_pd(dest + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(dest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dest[i] = unpack_f32le(data + 4 * i);
+}
+
+void convert_f32_block(const float *src, double *dest, size_t count)
+{
+    size_t i = 0;
+
+#if defined(YSFX_HAVE_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128 f = _mm_loadu_ps(src + i);
+        _mm_storeu_pd(dest + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(dest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dest[i] = src[i];
+}
+
+void convert_s32_block(const int32_t *src, double *dest, size_t count, double scale)
+{
+    size_t i = 0;
+
+#if defined(YSFX_HAVE_SSE2)
+    const __m128d k = _mm_set1_pd(scale);
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_pd(dest + i, _mm_mul_pd(_mm_cvtepi32_pd(x), k));
+        _mm_storeu_pd(dest + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(x, x)), k));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dest[i] = src[i] * scale;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t h = (seed ^ 0x9e3779b97f4a7c15u) + size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdu;
+        h ^= h >> 32;
+    }
+    uint64_t word = 0;
+    memcpy(&word, bytes + i, size - i);
+    h = (h ^ word) * 0xc4ceb9fe1a85ec53u;
+    h ^= h >> 29;
+    return h;
+}
+
+hash_stream::hash_stream(uint64_t seed)
+    : m_hash(seed ^ 0x9e3779b97f4a7c15u)
+{
+}
+
+void hash_stream::mix(uint64_t word)
+{
+    m_hash = (m_hash ^ word) * 0xff51afd7ed558ccdu;
+    m_hash ^= m_hash >> 32;
+}
+
+void hash_stream::update(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t pending = (size_t)(m_size % 8);
+    m_size += size;
+
+    // complete the word which the last update has started
+    if (pending > 0) {
+        size_t count = std::min(8 - pending, size);
+        memcpy(m_tail + pending, bytes, count);
+        bytes += count;
+        size -= count;
+        if (pending + count < 8)
+            return;
+        uint64_t word;
+        memcpy(&word, m_tail, 8);
+        mix(word);
+    }
+
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        mix(word);
+    }
+    memcpy(m_tail, bytes, size);
+}
+
+void hash_stream::update_zeros(size_t size)
+{
+    static const uint8_t zeros[256] = {};
+    for (size_t count; size > 0; size -= count) {
+        count = std::min(size, sizeof(zeros));
+        update(zeros, count);
+    }
+}
+
+uint64_t hash_stream::digest() const
+{
+    size_t pending = (size_t)(m_size % 8);
+    uint64_t word = 0;
+    memcpy(&word, m_tail, pending);
+    uint64_t h = (m_hash + m_size) ^ word;
+    h *= 0xc4ceb9fe1a85ec53u;
+    h ^= h >> 29;
+    return h;
+}
+
 //------------------------------------------------------------------------------
 
 std::vector<uint8_t> decode_base64(const char *text, size_t len)
@@ -420,6 +679,32 @@ bool get_handle_file_uid(void *handle, file_uid &uid)
 }
 #endif
 
+bool get_file_stamp(const char *path, file_stamp &stamp)
+{
+#if !defined(_WIN32)
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+#if defined(__APPLE__)
+    const struct timespec &mtim = st.st_mtimespec;
+#else
+    const struct timespec &mtim = st.st_mtim;
+#endif
+    stamp.mtime = (int64_t)mtim.tv_sec * 1000000000 + (int64_t)mtim.tv_nsec;
+    stamp.size = (uint64_t)st.st_size;
+    return true;
+#else
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(widen(path).c_str(), GetFileExInfoStandard, &data))
+        return false;
+    // 100-nanosecond intervals
+    uint64_t mtime = (uint64_t)data.ftLastWriteTime.dwLowDateTime | ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32);
+    stamp.mtime = (int64_t)mtime * 100;
+    stamp.size = (uint64_t)data.nFileSizeLow | ((uint64_t)data.nFileSizeHigh << 32);
+    return true;
+#endif
+}
+
 //------------------------------------------------------------------------------
 
 bool is_path_separator(char ch)
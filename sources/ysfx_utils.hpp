@@ -35,6 +35,7 @@
 #if defined(YSFX_NO_STANDARD_MUTEX)
 #   include "WDL/mutex.h"
 #endif
+#include "utility/biased_mutex.hpp"
 
 namespace ysfx {
 
@@ -44,6 +45,19 @@ FILE *fopen_utf8(const char *path, const char *mode);
 int64_t fseek_lfs(FILE *stream, int64_t off, int whence);
 int64_t ftell_lfs(FILE *stream);
 
+// a read-only view of the whole contents of a file
+struct mapped_file {
+    const uint8_t *data = nullptr;
+    uint64_t size = 0;
+#if defined(_WIN32)
+    void *mapping = nullptr;
+#endif
+};
+
+// map an open file, the view remains valid after the stream is closed
+bool map_stream_file(FILE *stream, mapped_file &map);
+void unmap_file(mapped_file &map);
+
 //------------------------------------------------------------------------------
 
 #if !defined(_WIN32)
@@ -80,12 +94,17 @@ private:
 
 //------------------------------------------------------------------------------
 
+using biased_mutex = basic_biased_mutex<mutex>;
+
+//------------------------------------------------------------------------------
+
 using string_list = std::vector<std::string>;
 
 double c_atof(const char *text, c_locale_t loc);
 double c_strtod(const char *text, char **endp, c_locale_t loc);
 double dot_atof(const char *text);
 double dot_strtod(const char *text, char **endp);
+double dot_strtod_n(const char *first, const char *last, const char **endp);
 bool ascii_isspace(char c);
 bool ascii_isalpha(char c);
 char ascii_tolower(char c);
@@ -104,6 +123,32 @@ void pack_u32le(uint32_t value, uint8_t data[4]);
 void pack_f32le(float value, uint8_t data[4]);
 uint32_t unpack_u32le(const uint8_t data[4]);
 float unpack_f32le(const uint8_t data[4]);
+void pack_f32le_block(const double *src, uint8_t *data, size_t count);
+void unpack_f32le_block(const uint8_t *data, double *dest, size_t count);
+void convert_f32_block(const float *src, double *dest, size_t count);
+void convert_s32_block(const int32_t *src, double *dest, size_t count, double scale);
+
+//------------------------------------------------------------------------------
+
+// a fast non-cryptographic hash, which can be continued over several pieces
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+
+// a hash of a stream of bytes, which does not depend on how it is split
+class hash_stream {
+public:
+    explicit hash_stream(uint64_t seed = 0);
+    void update(const void *data, size_t size);
+    // update with a run of zero bytes
+    void update_zeros(size_t size);
+    uint64_t digest() const;
+
+private:
+    void mix(uint64_t word);
+
+    uint64_t m_hash = 0;
+    uint64_t m_size = 0;
+    uint8_t m_tail[8]{};
+};
 
 //------------------------------------------------------------------------------
 
@@ -120,6 +165,15 @@ bool get_descriptor_file_uid(int fd, file_uid &uid);
 bool get_handle_file_uid(void *handle, file_uid &uid);
 #endif
 
+// modification time (in nanoseconds) and size, which tell if a file changed
+struct file_stamp {
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    bool operator==(const file_stamp &other) const { return mtime == other.mtime && size == other.size; }
+    bool operator!=(const file_stamp &other) const { return !operator==(other); }
+};
+bool get_file_stamp(const char *path, file_stamp &stamp);
+
 //------------------------------------------------------------------------------
 
 struct split_path_t {
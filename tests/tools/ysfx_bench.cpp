@@ -0,0 +1,215 @@
+#include "ysfx.h"
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Benchmarks of the effect host, one for each subcommand.
+// usage: ysfx_bench <benchmark> [count] [iterations]
+
+namespace {
+
+struct bench_t {
+    const char *name;
+    const char *description;
+    int count;
+    int iterations;
+    bool (*run)(int count, int iterations);
+};
+
+bool write_file(const char *path, const std::string &text)
+{
+    FILE *stream = fopen(path, "wb");
+    if (!stream)
+        return false;
+    bool ok = fwrite(text.data(), 1, text.size(), stream) == text.size();
+    return fclose(stream) == 0 && ok;
+}
+
+// loads the effect from the source text, and compiles it if requested
+ysfx_u load_effect(ysfx_config_t *config, const char *path, const std::string &text, bool compile)
+{
+    ysfx_u fx{ysfx_new(config)};
+    bool ok = write_file(path, text) && ysfx_load_file(fx.get(), path, 0) &&
+        (!compile || ysfx_compile(fx.get(), 0));
+    remove(path);
+    if (!ok)
+        fx.reset();
+    return fx;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+//------------------------------------------------------------------------------
+// the re-@init of an effect with many variables, which zeroes them all
+bool bench_reinit(int num_vars, int iterations)
+{
+    std::string text =
+        "desc:reinit benchmark" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n";
+    for (int i = 0; i < num_vars; ++i)
+        text += "v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx = load_effect(config.get(), "ysfx_bench_reinit.jsfx", text, true);
+    if (!fx)
+        return false;
+
+    // the first is not a re-@init
+    ysfx_init(fx.get());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        ysfx_init(fx.get());
+    auto end = std::chrono::steady_clock::now();
+
+    double total = elapsed_ms(start, end) * 1000;
+    printf("%d variables, %d iterations: %.2f us per @init\n", num_vars, iterations, total / iterations);
+    return true;
+}
+
+// the compilation of an effect whose sliders are all aliased to names,
+// with code which references many variables that are not aliases
+bool bench_alias(int num_lines, int iterations)
+{
+    std::string text =
+        "desc:alias benchmark" "\n"
+        "out_pin:output" "\n";
+    for (uint32_t i = 0; i < ysfx_max_sliders; ++i)
+        text += "slider" + std::to_string(i + 1) + ":Param" + std::to_string(i) + "=0<0,1,0.01>param" "\n";
+    text += "@init" "\n";
+    for (int i = 0; i < num_lines; ++i) {
+        uint32_t s = (uint32_t)i % ysfx_max_sliders;
+        text += "v" + std::to_string(i) + " = param" + std::to_string(s) + " * PARAM" + std::to_string((s + 1) % ysfx_max_sliders) + ";\n";
+    }
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx = load_effect(config.get(), "ysfx_bench_alias.jsfx", text, false);
+    if (!fx)
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        if (!ysfx_compile(fx.get(), 0))
+            return false;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double total = elapsed_ms(start, end);
+    printf("%u aliases, %d lines, %d iterations: %.2f ms per compile\n", ysfx_max_sliders, num_lines, iterations, total / iterations);
+    return true;
+}
+
+// the reading of a comma-separated text table into memory with file_mem in @init
+bool bench_textfile(int num_values, int iterations)
+{
+    std::string table;
+    for (int i = 0; i < num_values; ++i) {
+        table += std::to_string(i * 0.001 - 500);
+        table += ((i % 8) == 7) ? "\n" : ",";
+    }
+
+    std::string text =
+        "desc:text file benchmark" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "h = file_open(\"ysfx_bench_textfile.txt\");" "\n"
+        "count = file_mem(h, 0, " + std::to_string(num_values) + ");" "\n"
+        "file_close(h);" "\n";
+
+    const char *data_path = "ysfx_bench_textfile.txt";
+    if (!write_file(data_path, table))
+        return false;
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_set_data_root(config.get(), ".");
+    ysfx_u fx = load_effect(config.get(), "ysfx_bench_textfile.jsfx", text, true);
+
+    double total = 0;
+    bool ok = fx != nullptr;
+    for (int i = 0; ok && i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        ysfx_init(fx.get());
+        auto end = std::chrono::steady_clock::now();
+        total += elapsed_ms(start, end);
+        ok = ysfx_read_var(fx.get(), "count") == num_values;
+    }
+    remove(data_path);
+    if (!ok)
+        return false;
+
+    printf("%d values, %d iterations: %.2f ms per @init\n", num_values, iterations, total / iterations);
+    return true;
+}
+
+// saving and loading the state of an effect which serializes a large buffer with file_mem
+bool bench_serialize(int num_values, int iterations)
+{
+    std::string text =
+        "desc:serialization benchmark" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "i = 0; loop(" + std::to_string(num_values) + ", i[0] = i * 0.25; i += 1);" "\n"
+        "@serialize" "\n"
+        "count = file_mem(0, 0, " + std::to_string(num_values) + ");" "\n";
+
+    ysfx_config_u config{ysfx_config_new()};
+    ysfx_u fx = load_effect(config.get(), "ysfx_bench_serialize.jsfx", text, true);
+    if (!fx)
+        return false;
+    ysfx_init(fx.get());
+
+    double total_save = 0;
+    double total_load = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        auto middle = std::chrono::steady_clock::now();
+        bool ok = state && ysfx_load_state(fx.get(), state.get());
+        auto end = std::chrono::steady_clock::now();
+        total_save += elapsed_ms(start, middle);
+        total_load += elapsed_ms(middle, end);
+        if (!ok || ysfx_read_var(fx.get(), "count") != num_values)
+            return false;
+    }
+
+    printf("%d values, %d iterations: %.2f ms per save, %.2f ms per load\n", num_values, iterations, total_save / iterations, total_load / iterations);
+    return true;
+}
+
+const bench_t benches[] = {
+    {"reinit", "re-@init of many variables [variable-count] [iterations]", 10000, 1000, &bench_reinit},
+    {"alias", "compilation with slider aliases [line-count] [iterations]", 10000, 20, &bench_alias},
+    {"textfile", "text table read by file_mem [value-count] [iterations]", 1000000, 5, &bench_textfile},
+    {"serialize", "state save and load by file_mem [value-count] [iterations]", 4000000, 5, &bench_serialize},
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const bench_t *bench = nullptr;
+    for (const bench_t &b : benches) {
+        if (argc > 1 && !strcmp(argv[1], b.name))
+            bench = &b;
+    }
+
+    if (!bench) {
+        fprintf(stderr, "usage: ysfx_bench <benchmark> [count] [iterations]\n");
+        for (const bench_t &b : benches)
+            fprintf(stderr, "  %-10s %s\n", b.name, b.description);
+        return 1;
+    }
+
+    int count = (argc > 2) ? atoi(argv[2]) : bench->count;
+    int iterations = (argc > 3) ? atoi(argv[3]) : bench->iterations;
+    if (count < 1 || iterations < 1)
+        return 1;
+
+    return bench->run(count, iterations) ? 0 : 1;
+}
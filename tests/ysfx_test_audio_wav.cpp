@@ -21,6 +21,8 @@
 #include "ysfx_utils.hpp"
 #include <catch.hpp>
 #include <random>
+#include <vector>
+#include <cstring>
 
 #if defined(__GNUC__)
 #   pragma GCC diagnostic push
@@ -97,4 +99,74 @@ TEST_CASE("wav audio format", "[wav]")
             }
         }
     }
+
+    SECTION("read wav file without loss")
+    {
+        scoped_new_txt wav_file("${root}/example.wav", nullptr, 0);
+
+        // larger than a decoding chunk, formats which f32 does not represent,
+        // and 8-bit which goes through f32
+        const uint32_t channels = 2;
+        const uint64_t totalframes = 20000;
+        const uint64_t totalsmpls = channels * totalframes;
+
+        for (uint32_t bits : {8u, 24u, 32u, 64u}) {
+            drwav_data_format fmt{};
+            fmt.container = drwav_container_riff;
+            fmt.format = (bits == 64) ? DR_WAVE_FORMAT_IEEE_FLOAT : DR_WAVE_FORMAT_PCM;
+            fmt.channels = channels;
+            fmt.sampleRate = 48000;
+            fmt.bitsPerSample = bits;
+
+            std::vector<ysfx_real> expected((size_t)totalsmpls);
+            std::vector<uint8_t> data((size_t)totalsmpls * bits / 8);
+            std::mt19937_64 prng;
+            for (size_t i = 0; i < (size_t)totalsmpls; ++i) {
+                uint8_t *dst = &data[i * bits / 8];
+                if (bits == 64) {
+                    double value = std::uniform_real_distribution<double>{-1.0, 1.0}(prng);
+                    memcpy(dst, &value, 8);
+                    expected[i] = value;
+                }
+                else if (bits == 8) {
+                    // unsigned, scaled by the library as it always was
+                    int value = std::uniform_int_distribution<int>{0, 255}(prng);
+                    dst[0] = (uint8_t)value;
+                    expected[i] = (ysfx_real)value / 127.5 - 1;
+                }
+                else {
+                    int64_t range = (int64_t)1 << (bits - 1);
+                    int64_t value = std::uniform_int_distribution<int64_t>{-range, range - 1}(prng);
+                    for (uint32_t b = 0; b < bits / 8; ++b)
+                        dst[b] = (uint8_t)((uint64_t)value >> (8 * b));
+                    expected[i] = (ysfx_real)value / (ysfx_real)range;
+                }
+            }
+            {
+                drwav wav;
+                REQUIRE(drwav_init_file_write(&wav, wav_file.m_path.c_str(), &fmt, nullptr));
+                uint64_t written = drwav_write_pcm_frames(&wav, totalframes, data.data());
+                drwav_uninit(&wav);
+                REQUIRE(written == totalframes);
+            }
+
+            ysfx_audio_reader_t *reader = ysfx_audio_format_wav.open(wav_file.m_path.c_str());
+            REQUIRE(reader);
+            auto reader_cleanup = ysfx::defer([reader]() { ysfx_audio_format_wav.close(reader); });
+
+            // an odd count leaves a partial frame for the next read
+            std::vector<ysfx_real> buf((size_t)totalsmpls);
+            uint64_t first = totalsmpls / 2 + 1;
+            REQUIRE(ysfx_audio_format_wav.read(reader, buf.data(), first) == first);
+            REQUIRE(ysfx_audio_format_wav.read(reader, buf.data() + first, totalsmpls - first) == totalsmpls - first);
+            REQUIRE(ysfx_audio_format_wav.avail(reader) == 0);
+            if (bits == 8) {
+                // converted through f32
+                for (size_t i = 0; i < (size_t)totalsmpls; ++i)
+                    REQUIRE(buf[i] == Approx(expected[i]).margin(1e-6));
+            }
+            else
+                REQUIRE(buf == expected);
+        }
+    }
 }
@@ -0,0 +1,361 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "ysfx.h"
+#include "ysfx_test_utils.hpp"
+#include <catch.hpp>
+#include <vector>
+#include <thread>
+#include <cstring>
+
+#if !defined(YSFX_NO_GFX)
+TEST_CASE("graphics", "[gfx]")
+{
+    // renders with each of the features, colored after the first slider
+    const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "slider1:0<0,100,1>Seed" "\n"
+        "@gfx 64 64" "\n"
+        "gfx_set(slider1 * 0.01, 0.5, 0.25, 1);" "\n"
+        "gfx_rect(0, 0, gfx_w, gfx_h);" "\n"
+        "gfx_setimgdim(0, 32, 32);" "\n"
+        "gfx_dest = 0;" "\n"
+        "gfx_set(0, 0, 0, 1);" "\n"
+        "gfx_rect(0, 0, 32, 32);" "\n"
+        "gfx_set(1, 1, slider1 * 0.01, 1);" "\n"
+        "gfx_circle(16, 16, 10, 1);" "\n"
+        "gfx_dest = -1;" "\n"
+        "gfx_setfont(1, \"Arial\", 10 + slider1 % 7);" "\n"
+        "gfx_x = 4; gfx_y = 4;" "\n"
+        "gfx_drawstr(\"Text #\", 0);" "\n"
+        "gfx_drawnumber(slider1, 0);" "\n"
+        "gfx_x = 20; gfx_y = 30;" "\n"
+        "gfx_blit(0, 1, 0.25 * slider1);" "\n"
+        "frames += 1;" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    const uint32_t w = 64;
+    const uint32_t h = 64;
+
+    struct instance {
+        ysfx_u fx;
+        std::vector<uint8_t> pixels;
+    };
+
+    auto new_instance = [&](uint32_t seed) -> instance {
+        ysfx_config_u config{ysfx_config_new()};
+        instance ins;
+        ins.fx.reset(ysfx_new(config.get()));
+        REQUIRE(ysfx_load_file(ins.fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(ins.fx.get(), 0));
+        ysfx_slider_set_value(ins.fx.get(), 0, (ysfx_real)seed, true);
+        ysfx_init(ins.fx.get());
+        ins.pixels.resize(4 * w * h);
+
+        ysfx_gfx_config_t gc{};
+        gc.pixel_width = w;
+        gc.pixel_height = h;
+        gc.pixels = ins.pixels.data();
+        gc.scale_factor = 1.0;
+        ysfx_gfx_setup(ins.fx.get(), &gc);
+        return ins;
+    };
+
+    SECTION("concurrent instances")
+    {
+        const uint32_t count = 16;
+        const uint32_t frames = 50;
+
+        // the reference images, drawn one at a time
+        std::vector<std::vector<uint8_t>> expected(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            instance ins = new_instance(i);
+            ysfx_gfx_run(ins.fx.get());
+            expected[i] = ins.pixels;
+        }
+
+        // each instance draws on its own thread
+        std::vector<instance> instances;
+        for (uint32_t i = 0; i < count; ++i)
+            instances.push_back(new_instance(i));
+
+        std::vector<std::thread> threads;
+        std::vector<int> matches(count, 0);
+        for (uint32_t i = 0; i < count; ++i) {
+            threads.emplace_back([&, i]() {
+                ysfx_t *fx = instances[i].fx.get();
+                int ok = 1;
+                for (uint32_t f = 0; f < frames; ++f) {
+                    ysfx_gfx_run(fx);
+                    ok &= instances[i].pixels == expected[i];
+                }
+                matches[i] = ok;
+            });
+        }
+        for (std::thread &t : threads)
+            t.join();
+
+        for (uint32_t i = 0; i < count; ++i) {
+            REQUIRE(ysfx_read_var(instances[i].fx.get(), "frames") == frames);
+            REQUIRE(matches[i]);
+        }
+    }
+}
+
+TEST_CASE("graphics dirty rects", "[gfx]")
+{
+    // slider1 picks what to draw
+    const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "slider1:0<0,5,1>Mode" "\n"
+        "@gfx 64 64" "\n"
+        "gfx_clear = slider1 == 3 ? 0 : -1;" "\n"
+        "gfx_set(1, 1, 1, 1);" "\n"
+        "slider1 == 1 ? gfx_rect(10, 20, 5, 6);" "\n"
+        "slider1 == 2 ? (gfx_rect(2, 2, 4, 4); gfx_rect(40, 40, 4, 4); gfx_rect(4, 4, 4, 4));" "\n"
+        "slider1 == 3 ? gfx_rect(10, 20, 5, 6);" "\n"
+        "slider1 == 4 ? (gfx_x = 0; loop(40, gfx_setpixel(1, 1, 1); gfx_x += 3; gfx_y += 3));" "\n"
+        "slider1 == 5 ? (gfx_x = 10; gfx_y = 20; gfx_drawstr(\"longer\\nab\"); gfx_drawnumber(1, 0); gfx_drawchar('c'));" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+    const uint32_t w = 64;
+    const uint32_t h = 64;
+    std::vector<uint8_t> pixels(4 * w * h);
+
+    auto run = [&](uint32_t mode, std::vector<ysfx_gfx_rect_t> &rects) {
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_slider_set_value(fx.get(), 0, (ysfx_real)mode, true);
+        ysfx_init(fx.get());
+
+        ysfx_gfx_config_t gc{};
+        gc.pixel_width = w;
+        gc.pixel_height = h;
+        gc.pixels = pixels.data();
+        gc.scale_factor = 1.0;
+        ysfx_gfx_setup(fx.get(), &gc);
+        ysfx_gfx_run(fx.get());
+
+        rects.resize(16);
+        uint32_t count = ysfx_gfx_get_dirty_rects(fx.get(), rects.data(), (uint32_t)rects.size());
+        REQUIRE(count <= rects.size());
+        rects.resize(count);
+    };
+
+    auto contains = [](const ysfx_gfx_rect_t &r, int32_t x, int32_t y, int32_t rw, int32_t rh) -> bool {
+        return r.x <= x && r.y <= y && r.x + r.w >= x + rw && r.y + r.h >= y + rh;
+    };
+
+    std::vector<ysfx_gfx_rect_t> rects;
+
+    SECTION("nothing drawn")
+    {
+        run(0, rects);
+        REQUIRE(rects.empty());
+    }
+
+    SECTION("one area")
+    {
+        run(1, rects);
+        REQUIRE(rects.size() == 1);
+        REQUIRE(contains(rects[0], 10, 20, 5, 6));
+        REQUIRE(rects[0].w < 16);
+        REQUIRE(rects[0].h < 16);
+    }
+
+    SECTION("overlapping areas merge")
+    {
+        run(2, rects);
+        REQUIRE(rects.size() == 2);
+        const ysfx_gfx_rect_t &a = (rects[0].x < rects[1].x) ? rects[0] : rects[1];
+        const ysfx_gfx_rect_t &b = (rects[0].x < rects[1].x) ? rects[1] : rects[0];
+        REQUIRE(contains(a, 2, 2, 6, 6));
+        REQUIRE(contains(b, 40, 40, 4, 4));
+        REQUIRE(a.x + a.w < b.x);
+    }
+
+    SECTION("cleared frame")
+    {
+        run(3, rects);
+        REQUIRE(rects.size() == 1);
+        REQUIRE(contains(rects[0], 0, 0, (int32_t)w, (int32_t)h));
+    }
+
+    SECTION("many areas stay few")
+    {
+        run(4, rects);
+        REQUIRE(!rects.empty());
+        REQUIRE(rects.size() <= 16);
+        for (uint32_t i = 0; i < 40; ++i) {
+            int32_t x = (int32_t)(3 * i), y = (int32_t)(3 * i);
+            if (x >= (int32_t)w || y >= (int32_t)h)
+                continue;
+            bool found = false;
+            for (const ysfx_gfx_rect_t &r : rects)
+                found = found || contains(r, x, y, 1, 1);
+            REQUIRE(found);
+        }
+        for (const ysfx_gfx_rect_t &r : rects) {
+            REQUIRE(r.x >= 0);
+            REQUIRE(r.y >= 0);
+            REQUIRE(r.x + r.w <= (int32_t)w);
+            REQUIRE(r.y + r.h <= (int32_t)h);
+        }
+    }
+
+    SECTION("text")
+    {
+        run(5, rects);
+        REQUIRE(!rects.empty());
+        bool drawn = false;
+        for (uint32_t y = 0; y < h; ++y) {
+            for (uint32_t x = 0; x < w; ++x) {
+                const uint8_t *px = &pixels[4 * (y * w + x)];
+                if (!(px[0] | px[1] | px[2]))
+                    continue;
+                drawn = true;
+                bool found = false;
+                for (const ysfx_gfx_rect_t &r : rects)
+                    found = found || contains(r, (int32_t)x, (int32_t)y, 1, 1);
+                REQUIRE(found);
+            }
+        }
+        REQUIRE(drawn);
+        for (const ysfx_gfx_rect_t &r : rects) {
+            REQUIRE(r.x >= 8);
+            REQUIRE(r.y >= 18);
+        }
+    }
+}
+
+TEST_CASE("graphics image cache", "[gfx]")
+{
+    // a 2x2 image, red, green, blue and white
+    const char png[] =
+        "\x89\x50\x4e\x47\x0d\x0a\x1a\x0a\x00\x00\x00\x0d\x49\x48\x44\x52"
+        "\x00\x00\x00\x02\x00\x00\x00\x02\x08\x06\x00\x00\x00\x72\xb6\x0d"
+        "\x24\x00\x00\x00\x12\x49\x44\x41\x54\x78\x9c\x63\xf8\xcf\xc0\xf0"
+        "\x1f\x0c\x81\x34\x18\x00\x00\x49\xc8\x09\xf7\xf9\xab\xb6\x0d\x00"
+        "\x00\x00\x00\x49\x45\x4e\x44\xae\x42\x60\x82";
+
+    // slider1 draws into the image, before it is displayed
+    const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "filename:0,image.png" "\n"
+        "slider1:0<0,1,1>Draw into" "\n"
+        "@gfx 8 8" "\n"
+        "slider1 ? (gfx_dest = 0; gfx_set(0, 0, 1, 1); gfx_rect(0, 0, 1, 1); gfx_dest = -1);" "\n"
+        "gfx_getimgdim(0, w, h);" "\n"
+        "gfx_set(1, 1, 1, 1);" "\n"
+        "gfx_x = 0; gfx_y = 0;" "\n"
+        "gfx_blit(0, 1, 0);" "\n";
+
+    scoped_new_dir dir_fx("${root}/Effects");
+    scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+    scoped_new_txt file_png("${root}/Effects/image.png", png, sizeof(png) - 1);
+
+    const uint32_t w = 8;
+    const uint32_t h = 8;
+
+    struct instance {
+        ysfx_u fx;
+        std::vector<uint8_t> pixels;
+
+        // the color of a pixel, as 0xRRGGBB
+        uint32_t color(uint32_t x, uint32_t y) const
+        {
+            const uint8_t *p = &pixels[4 * (y * w + x)];
+            return ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+        }
+        uint64_t image_bytes() const
+        {
+            ysfx_memory_stats_t stats{};
+            ysfx_get_memory_stats(fx.get(), 0, &stats);
+            return stats.image_bytes;
+        }
+    };
+
+    auto run_instance = [&](bool draw_into) -> instance {
+        ysfx_config_u config{ysfx_config_new()};
+        instance ins;
+        ins.fx.reset(ysfx_new(config.get()));
+        REQUIRE(ysfx_load_file(ins.fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(ins.fx.get(), 0));
+        ysfx_slider_set_value(ins.fx.get(), 0, draw_into ? 1 : 0, true);
+        ysfx_init(ins.fx.get());
+        ins.pixels.resize(4 * w * h);
+
+        ysfx_gfx_config_t gc{};
+        gc.pixel_width = w;
+        gc.pixel_height = h;
+        gc.pixels = ins.pixels.data();
+        gc.scale_factor = 1.0;
+        ysfx_gfx_setup(ins.fx.get(), &gc);
+        ysfx_gfx_run(ins.fx.get());
+        REQUIRE(ysfx_read_var(ins.fx.get(), "w") == 2);
+        REQUIRE(ysfx_read_var(ins.fx.get(), "h") == 2);
+        return ins;
+    };
+
+    SECTION("shared until drawn into")
+    {
+        ysfx_set_image_cache_budget(0);
+        ysfx_set_image_cache_budget(64 * 1024 * 1024);
+
+        instance a = run_instance(false);
+        instance b = run_instance(false);
+        REQUIRE(a.image_bytes() == 0);
+        REQUIRE(b.image_bytes() == 0);
+        for (const instance *ins : {&a, &b}) {
+            REQUIRE(ins->color(0, 0) == 0xff0000);
+            REQUIRE(ins->color(1, 0) == 0x00ff00);
+            REQUIRE(ins->color(0, 1) == 0x0000ff);
+            REQUIRE(ins->color(1, 1) == 0xffffff);
+        }
+
+        // the copy is private to the instance which draws
+        instance c = run_instance(true);
+        REQUIRE(c.image_bytes() > 0);
+        REQUIRE(c.color(0, 0) == 0x0000ff);
+        REQUIRE(c.color(1, 0) == 0x00ff00);
+
+        ysfx_gfx_run(a.fx.get());
+        REQUIRE(a.color(0, 0) == 0xff0000);
+    }
+
+    SECTION("without the cache")
+    {
+        ysfx_set_image_cache_budget(0);
+
+        instance a = run_instance(false);
+        REQUIRE(a.image_bytes() > 0);
+        REQUIRE(a.color(0, 0) == 0xff0000);
+        REQUIRE(a.color(1, 1) == 0xffffff);
+
+        ysfx_set_image_cache_budget(128 * 1024 * 1024);
+    }
+}
+#endif
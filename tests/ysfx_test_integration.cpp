@@ -20,9 +20,70 @@
 #include "ysfx_api_eel.hpp"
 #include "ysfx_gmem.hpp"
 #include "ysfx.hpp"
+#include "ysfx_utils.hpp"
 #include <catch.hpp>
 
 #include <iostream>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <memory>
+#if defined(__linux__)
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+namespace {
+    // an audio format whose files are text with the number of samples in them
+    std::atomic<int> fake_audio_opens{0};
+
+    struct fake_audio_reader {
+        uint64_t count = 0;
+        uint64_t pos = 0;
+    };
+
+    ysfx_audio_format_t fake_audio_format()
+    {
+        ysfx_audio_format_t fmt{};
+        fmt.can_handle = [](const char *path) -> bool {
+            return ysfx::path_has_suffix(path, "fake");
+        };
+        fmt.open = [](const char *path) -> ysfx_audio_reader_t * {
+            FILE *stream = fopen(path, "rb");
+            if (!stream)
+                return nullptr;
+            fake_audio_reader *reader = new fake_audio_reader;
+            unsigned long long count = 0;
+            if (fscanf(stream, "%llu", &count) == 1)
+                reader->count = count;
+            fclose(stream);
+            ++fake_audio_opens;
+            return (ysfx_audio_reader_t *)reader;
+        };
+        fmt.close = [](ysfx_audio_reader_t *reader) {
+            delete (fake_audio_reader *)reader;
+        };
+        fmt.info = [](ysfx_audio_reader_t *) -> ysfx_audio_file_info_t {
+            return {2, 48000};
+        };
+        fmt.avail = [](ysfx_audio_reader_t *reader_) -> uint64_t {
+            fake_audio_reader *reader = (fake_audio_reader *)reader_;
+            return reader->count - reader->pos;
+        };
+        fmt.rewind = [](ysfx_audio_reader_t *reader) {
+            ((fake_audio_reader *)reader)->pos = 0;
+        };
+        fmt.read = [](ysfx_audio_reader_t *reader_, ysfx_real *samples, uint64_t count) -> uint64_t {
+            fake_audio_reader *reader = (fake_audio_reader *)reader_;
+            uint64_t n = 0;
+            for (; n < count && reader->pos < reader->count; ++n)
+                samples[n] = 0.5 * (ysfx_real)reader->pos++;
+            return n;
+        };
+        return fmt;
+    }
+}
 
 TEST_CASE("integration", "[integration]")
 {
@@ -332,6 +393,322 @@ TEST_CASE("integration", "[integration]")
         REQUIRE(ysfx_calculate_used_mem(fx.get()) == 13434880);  // Note that this always rounds to the next full block
     };
 
+    SECTION("memory stats")
+    {
+        const char *text =
+        "desc:test" "\n"
+        "options:gmem=memstats" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "mem[0] = 1;" "\n"
+        "mem[3 * 65536] = 1;" "\n"
+        "gmem[0] = 1;" "\n"
+        "#str = \"abcdef\";" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        const uint64_t block_bytes = 65536 * sizeof(ysfx_real);
+        ysfx_memory_stats_t stats;
+        ysfx_get_memory_stats(fx.get(), 0, &stats);
+        REQUIRE(stats.vm_bytes == 2 * block_bytes);
+        REQUIRE(stats.gmem_bytes == block_bytes);
+        REQUIRE(stats.string_bytes == 0);  // not requested
+        REQUIRE(stats.file_handles == 1);  // the serializer
+        REQUIRE(ysfx_calculate_used_mem(fx.get()) == 2 * 65536);
+
+        ysfx_get_memory_stats(fx.get(), ysfx_memory_stats_strings, &stats);
+        REQUIRE(stats.string_bytes >= 6);
+
+        ysfx_unload(fx.get());
+        ysfx_get_memory_stats(fx.get(), 0, &stats);
+        REQUIRE(stats.vm_bytes == 0);
+        REQUIRE(ysfx_calculate_used_mem(fx.get()) == 0);
+    };
+
+    SECTION("raw file_mem")
+    {
+        const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "h = file_open(\"floats.dat\");" "\n"
+        "avail0 = file_avail(h);" "\n"
+        "file_var(h, first);" "\n"
+        "read = file_mem(h, 65530, 69999);" "\n"
+        "avail1 = file_avail(h);" "\n"
+        "file_rewind(h);" "\n"
+        "avail2 = file_avail(h);" "\n"
+        "file_close(h);" "\n";
+
+        const uint32_t count = 70000;
+        std::string data(4 * count, '\0');
+        for (uint32_t i = 0; i < count; ++i)
+            ysfx::pack_f32le(0.5f * (float)i - 100.0f, (uint8_t *)&data[4 * i]);
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_dir dir_data("${root}/Data");
+        scoped_new_txt file_data("${root}/Data/floats.dat", data.data(), data.size());
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_data_root(config.get(), dir_data.m_path.c_str());
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(ysfx_read_var(fx.get(), "avail0") == count);
+        REQUIRE(ysfx_read_var(fx.get(), "first") == -100);
+        REQUIRE(ysfx_read_var(fx.get(), "read") == count - 1);
+        REQUIRE(ysfx_read_var(fx.get(), "avail1") == 0);
+        REQUIRE(ysfx_read_var(fx.get(), "avail2") == count);
+
+        // the copy crosses from one block of memory into the next
+        for (uint32_t i = 1; i < count; ++i)
+            REQUIRE(ysfx_read_vmem_single(fx.get(), 65530 + i - 1) == 0.5 * i - 100.0);
+    };
+
+    SECTION("text file_mem")
+    {
+        const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "h = file_open(\"table.txt\");" "\n"
+        "file_var(h, first);" "\n"
+        "read = file_mem(h, 65530, 1000000);" "\n"
+        "avail = file_avail(h);" "\n"
+        "file_rewind(h);" "\n"
+        "file_string(h, 5);" "\n"
+        "file_close(h);" "\n";
+
+        // invalid lines are skipped, and the file is larger than one input chunk
+        std::string table = " +1.5,not a number\n0x10,-2e3\n\n";
+        const uint32_t count = 20000;
+        for (uint32_t i = 0; i < count; ++i)
+            table += std::to_string(i) + ".25" + ((i % 3) ? "," : "\r\n");
+        table += "-7";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_dir dir_data("${root}/Data");
+        scoped_new_txt file_data("${root}/Data/table.txt", table.c_str());
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_data_root(config.get(), dir_data.m_path.c_str());
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        REQUIRE(ysfx_read_var(fx.get(), "first") == 1.5);
+        REQUIRE(ysfx_read_var(fx.get(), "read") == count + 3);
+        REQUIRE(ysfx_read_var(fx.get(), "avail") == 0);
+        REQUIRE(ysfx_read_vmem_single(fx.get(), 65530) == 16);
+        REQUIRE(ysfx_read_vmem_single(fx.get(), 65531) == -2000);
+        for (uint32_t i = 0; i < count; ++i)
+            REQUIRE(ysfx_read_vmem_single(fx.get(), 65532 + i) == i + 0.25);
+        REQUIRE(ysfx_read_vmem_single(fx.get(), 65532 + count) == -7);
+
+        std::string line;
+        ysfx_string_get(fx.get(), 5, line);
+        REQUIRE(line == " +1.5,not a number\n");
+    };
+
+    SECTION("file handles")
+    {
+        const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "opened = 0;" "\n"
+        "while ((h = file_open(\"value.txt\")) >= 0) (" "\n"
+        "  1000[opened] = h;" "\n"
+        "  opened += 1;" "\n"
+        ");" "\n"
+        "first = 1000[0];" "\n"
+        "closed = file_close(first);" "\n"
+        "closed_again = file_close(first);" "\n"
+        "reopened = file_open(\"value.txt\");" "\n"
+        "stale = file_var(first, x);" "\n"
+        "valid = file_var(reopened, y);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_dir dir_data("${root}/Data");
+        scoped_new_txt file_data("${root}/Data/value.txt", "42");
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_data_root(config.get(), dir_data.m_path.c_str());
+        ysfx_set_max_file_handles(config.get(), 200);
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        // the serializer takes one of the handles
+        REQUIRE(ysfx_read_var(fx.get(), "opened") == 199);
+        REQUIRE(ysfx_read_var(fx.get(), "first") == 1);
+        REQUIRE(ysfx_read_var(fx.get(), "closed") == 0);
+        REQUIRE(ysfx_read_var(fx.get(), "closed_again") == -1);
+
+        // the slot is reused, but the old handle does not designate it
+        REQUIRE(ysfx_read_var(fx.get(), "reopened") >= 0);
+        REQUIRE(ysfx_read_var(fx.get(), "reopened") != 1);
+        REQUIRE(ysfx_read_var(fx.get(), "stale") == 0);
+        REQUIRE(ysfx_read_var(fx.get(), "valid") == 1);
+        REQUIRE(ysfx_read_var(fx.get(), "y") == 42);
+
+        ysfx_memory_stats_t stats{};
+        ysfx_get_memory_stats(fx.get(), 0, &stats);
+        REQUIRE(stats.file_handles == 200);
+
+        // reinitializing closes the files, and invalidates their handles
+        ysfx_init(fx.get());
+        REQUIRE(ysfx_read_var(fx.get(), "opened") == 199);
+        REQUIRE(ysfx_read_var(fx.get(), "first") != 1);
+    };
+
+    SECTION("audio file cache")
+    {
+        const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "h = file_open(\"sound.fake\");" "\n"
+        "file_riff(h, nch, srate);" "\n"
+        "avail = file_avail(h);" "\n"
+        "read = file_mem(h, 65530, avail);" "\n"
+        "file_close(h);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_dir dir_data("${root}/Data");
+        auto sound = std::make_unique<scoped_new_txt>("${root}/Data/sound.fake", "100000");
+
+        ysfx_audio_format_t fmt = fake_audio_format();
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_data_root(config.get(), dir_data.m_path.c_str());
+        ysfx_register_audio_format(config.get(), &fmt);
+
+        ysfx_set_audio_cache_budget(0);
+        ysfx_set_audio_cache_budget(64 * 1024 * 1024);
+        fake_audio_opens = 0;
+
+        // keep the background decoding going in between the instances
+        auto prefetcher = ysfx_audio_prefetcher_acquire();
+
+        auto run = [&](uint32_t expected) {
+            ysfx_u fx{ysfx_new(config.get())};
+            REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+            REQUIRE(ysfx_compile(fx.get(), 0));
+            ysfx_init(fx.get());
+            REQUIRE(ysfx_read_var(fx.get(), "nch") == 2);
+            REQUIRE(ysfx_read_var(fx.get(), "srate") == 48000);
+            REQUIRE(ysfx_read_var(fx.get(), "avail") == expected);
+            REQUIRE(ysfx_read_var(fx.get(), "read") == expected);
+            for (uint32_t i = 0; i < expected; i += 997)
+                REQUIRE(ysfx_read_vmem_single(fx.get(), 65530 + i) == 0.5 * i);
+            REQUIRE(ysfx_read_vmem_single(fx.get(), 65530 + expected - 1) == 0.5 * (expected - 1));
+        };
+
+        // the first open reads as it goes, and has the file decoded in the
+        // background, once for the instances which open it next
+        run(100000);
+        ysfx_audio_prefetcher_wait_idle(prefetcher.get());
+        REQUIRE(fake_audio_opens == 2);
+        run(100000);
+        run(100000);
+        REQUIRE(fake_audio_opens == 2);
+
+        // decoded again when the file changes, to a different size so that it
+        // is seen whatever the resolution of the modification time
+        sound.reset();
+        sound = std::make_unique<scoped_new_txt>("${root}/Data/sound.fake", "2000");
+        run(2000);
+        ysfx_audio_prefetcher_wait_idle(prefetcher.get());
+        REQUIRE(fake_audio_opens == 4);
+        run(2000);
+        REQUIRE(fake_audio_opens == 4);
+
+        // read from the format every time, without the cache
+        ysfx_set_audio_cache_budget(0);
+        run(2000);
+        run(2000);
+        ysfx_audio_prefetcher_wait_idle(prefetcher.get());
+        REQUIRE(fake_audio_opens == 6);
+
+        ysfx_set_audio_cache_budget(256 * 1024 * 1024);
+    };
+
+    SECTION("audio file prefetch")
+    {
+        const char *text =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "slider1:/sounds:1:Sound" "\n"
+        "@slider" "\n"
+        "h = file_open(slider1);" "\n"
+        "avail = file_avail(h);" "\n"
+        "file_close(h);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+        scoped_new_dir dir_data("${root}/Data");
+        scoped_new_dir dir_sounds("${root}/Data/sounds");
+        scoped_new_txt file_a("${root}/Data/sounds/a.fake", "100");
+        scoped_new_txt file_b("${root}/Data/sounds/b.fake", "200");
+        scoped_new_txt file_c("${root}/Data/sounds/c.fake", "300");
+        scoped_new_txt file_d("${root}/Data/sounds/d.fake", "400");
+
+        ysfx_audio_format_t fmt = fake_audio_format();
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_set_data_root(config.get(), dir_data.m_path.c_str());
+        ysfx_register_audio_format(config.get(), &fmt);
+
+        ysfx_set_audio_cache_budget(0);
+        ysfx_set_audio_cache_budget(64 * 1024 * 1024);
+        fake_audio_opens = 0;
+
+        auto prefetcher = ysfx_audio_prefetcher_acquire();
+
+        ysfx_u fx{ysfx_new(config.get())};
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_slider_get_value(fx.get(), 0) == 1);
+
+        // the selected file and its neighbours are decoded in the background
+        ysfx_audio_prefetcher_wait_idle(prefetcher.get());
+        REQUIRE(fake_audio_opens == 3);
+
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+        ysfx_process_double(fx.get(), nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_read_var(fx.get(), "avail") == 200);
+        REQUIRE(fake_audio_opens == 3);
+
+        // stepping to the next file prefetches the one after
+        ysfx_slider_set_value(fx.get(), 0, 2, true);
+        ysfx_audio_prefetcher_wait_idle(prefetcher.get());
+        REQUIRE(fake_audio_opens == 4);
+        ysfx_process_double(fx.get(), nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_read_var(fx.get(), "avail") == 300);
+        REQUIRE(fake_audio_opens == 4);
+
+        fx.reset();
+        ysfx_set_audio_cache_budget(256 * 1024 * 1024);
+    };
+
     SECTION("multi_config")
     {
         auto compile_and_check = [](const char *text, uint32_t ref_value, bool want_meter) {
@@ -467,6 +844,55 @@ TEST_CASE("integration", "[integration]")
         }
     };
 
+    SECTION("gmem attach, release and re-attach")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "options:gmem=GmemTesterRefs" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "a = gmem[4];" "\n"
+        "gmem[4] = 99;" "\n";
+
+        auto fx1 = get_compiled_fx(jsfx);
+        auto fx2 = get_compiled_fx(jsfx);
+        void **slot = get_gmem_address(fx1.get());
+        REQUIRE(slot);
+        REQUIRE(get_gmem_address(fx2.get()) == slot);
+
+        ysfx_init(fx1.get());
+        REQUIRE(ysfx_read_var(fx1.get(), "a") == 0);
+        void *ctx = *slot;
+        REQUIRE(ctx);
+
+        // attaching again to the same name keeps the context
+        ysfx_gmem_attach(fx1.get(), "GmemTesterRefs");
+        REQUIRE(get_gmem_address(fx1.get()) == slot);
+
+        // the context survives while a reference remains
+        ysfx_gmem_detach(fx1.get());
+        REQUIRE(get_gmem_address(fx1.get()) == nullptr);
+        REQUIRE(get_gmem_identifier(fx1.get()).empty());
+        ysfx_gmem_attach(fx1.get(), "GmemTesterRefs");
+        REQUIRE(get_gmem_address(fx1.get()) == slot);
+        REQUIRE(*slot == ctx);
+        ysfx_init(fx2.get());
+        REQUIRE(ysfx_read_var(fx2.get(), "a") == 99);
+
+        // the last reference releases it, a new one starts from zero
+        ysfx_gmem_detach(fx1.get());
+        ysfx_gmem_detach(fx2.get());
+        ysfx_gmem_attach(fx1.get(), "GmemTesterRefs");
+        REQUIRE(get_gmem_identifier(fx1.get()) == "GmemTesterRefs");
+        REQUIRE(*get_gmem_address(fx1.get()) == nullptr);
+        ysfx_init(fx1.get());
+        REQUIRE(ysfx_read_var(fx1.get(), "a") == 0);
+
+        // an empty name detaches
+        ysfx_gmem_attach(fx1.get(), "");
+        REQUIRE(get_gmem_address(fx1.get()) == nullptr);
+    };
+
     SECTION("read_jsfx")
     {
         const char *jsfx_write =
@@ -600,4 +1026,465 @@ TEST_CASE("integration", "[integration]")
         REQUIRE(ysfx_read_var(read2.get(), "a") == 0);
         REQUIRE(ysfx_read_var(read2.get(), "b") == 87654321);
     };
+
+#if defined(__linux__)
+    SECTION("test_gmem_shared_across_processes")
+    {
+        std::string gmem_name = "GmemTesterShared" + std::to_string(getpid());
+
+        std::string jsfx_writer =
+        "desc:test" "\n"
+        "options:gmem=" + gmem_name + "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "gmem[3] = 4242;" "\n"
+        "gmem[5000000] = 17;" "\n";
+
+        std::string jsfx_reader =
+        "desc:test" "\n"
+        "options:gmem=" + gmem_name + "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "a = gmem[3];" "\n"
+        "b = gmem[5000000];" "\n";
+
+        auto get_shared_fx = [](const std::string &text) {
+            scoped_new_dir dir_fx("${root}/Effects");
+            scoped_new_txt file_main("${root}/Effects/example.jsfx", text.c_str());
+
+            ysfx_config_u config{ysfx_config_new()};
+            REQUIRE(ysfx_set_shared_gmem(config.get(), true));
+            ysfx_u fx{ysfx_new(config.get())};
+
+            ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0);
+            ysfx_compile(fx.get(), 0);
+            return fx;
+        };
+
+        pid_t child = fork();
+        REQUIRE(child != -1);
+        if (child == 0) {
+            // let the writer live in another process entirely
+            auto writer = get_shared_fx(jsfx_writer);
+            ysfx_init(writer.get());
+            _exit(is_gmem_shared(writer.get()) ? 0 : 1);
+        }
+
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+
+        auto reader = get_shared_fx(jsfx_reader);
+        REQUIRE(is_gmem_shared(reader.get()));
+        ysfx_init(reader.get());
+        REQUIRE(ysfx_read_var(reader.get(), "a") == 4242);
+        REQUIRE(ysfx_read_var(reader.get(), "b") == 17);
+
+        // the snapshot holds only the blocks which were written
+        scoped_new_dir dir_snap("${root}/Snapshots");
+        std::string path = dir_snap.m_path + "/gmem.bin";
+        REQUIRE(ysfx_save_gmem_snapshot(reader.get(), path.c_str(), 1));
+        {
+            ysfx::FILE_u stream{ysfx::fopen_utf8(path.c_str(), "rb")};
+            REQUIRE(stream);
+            REQUIRE(ysfx::fseek_lfs(stream.get(), 0, SEEK_END) == 0);
+            REQUIRE(ysfx::ftell_lfs(stream.get()) < 4 * 1024 * 1024);
+        }
+        std::remove(path.c_str());
+
+        REQUIRE(ysfx_unlink_shared_gmem(gmem_name.c_str()));
+        REQUIRE(!ysfx_unlink_shared_gmem(gmem_name.c_str()));
+    };
+#endif
+
+    SECTION("test_gmem_snapshot")
+    {
+        const char *jsfx_writer =
+        "desc:test" "\n"
+        "options:gmem=GmemTesterSnapshot" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "gmem[7] = 1234;" "\n"
+        "gmem[3000000] = 5678;" "\n"
+        "gmem[6000000] = 0;" "\n";
+
+        const char *jsfx_reader =
+        "desc:test" "\n"
+        "options:gmem=GmemTesterSnapshot" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "a = gmem[7];" "\n"
+        "b = gmem[3000000];" "\n"
+        "gmem[7] = 0;" "\n";
+
+        const char *jsfx_other =
+        "desc:test" "\n"
+        "options:gmem=GmemTesterOther" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n";
+
+        scoped_new_dir dir_snap("${root}/Snapshots");
+        std::string path = dir_snap.m_path + "/gmem.bin";
+
+        {
+            auto writer = get_compiled_fx(jsfx_writer);
+            ysfx_init(writer.get());
+            REQUIRE(ysfx_save_gmem_snapshot(writer.get(), path.c_str(), 3));
+        }
+
+        for (int pass = 0; pass < 2; ++pass) {
+            auto reader = get_compiled_fx(jsfx_reader);
+            REQUIRE(!ysfx_load_gmem_snapshot(reader.get(), path.c_str(), 2));
+            REQUIRE(ysfx_load_gmem_snapshot(reader.get(), path.c_str(), 3));
+            REQUIRE(!ysfx_load_gmem_snapshot(reader.get(), path.c_str(), 3));
+            ysfx_init(reader.get());
+            REQUIRE(ysfx_read_var(reader.get(), "a") == 1234);
+            REQUIRE(ysfx_read_var(reader.get(), "b") == 5678);
+        }
+
+        auto other = get_compiled_fx(jsfx_other);
+        REQUIRE(!ysfx_load_gmem_snapshot(other.get(), path.c_str(), 3));
+
+        std::string data;
+        {
+            ysfx::FILE_u stream{ysfx::fopen_utf8(path.c_str(), "rb")};
+            REQUIRE(stream);
+            char buf[4096];
+            for (size_t count; (count = fread(buf, 1, sizeof(buf), stream.get())) > 0; )
+                data.append(buf, count);
+        }
+
+        // the block of zeros is left out, only the 2 others are stored
+        uint32_t block_count = 0;
+        const size_t block_count_offset = 36;
+        memcpy(&block_count, &data[block_count_offset], sizeof(block_count));
+        REQUIRE(block_count == 2);
+
+        auto load_modified = [&](const std::string &modified) -> bool {
+            std::string modified_path = dir_snap.m_path + "/modified.bin";
+            {
+                ysfx::FILE_u stream{ysfx::fopen_utf8(modified_path.c_str(), "wb")};
+                REQUIRE(stream);
+                REQUIRE(fwrite(modified.data(), 1, modified.size(), stream.get()) == modified.size());
+            }
+            auto reader = get_compiled_fx(jsfx_reader);
+            bool loaded = ysfx_load_gmem_snapshot(reader.get(), modified_path.c_str(), 3);
+            std::remove(modified_path.c_str());
+            return loaded;
+        };
+
+        REQUIRE(load_modified(data));
+
+        // a truncated file is rejected, rather than mapped beyond its end
+        REQUIRE(!load_modified(data.substr(0, data.size() - 1)));
+
+        // so is a block index which appears twice
+        const size_t indices_offset = 40 + strlen("GmemTesterSnapshot");
+        std::string duplicate = data;
+        memcpy(&duplicate[indices_offset + 4], &duplicate[indices_offset], 4);
+        REQUIRE(!load_modified(duplicate));
+
+        // and a data offset which points elsewhere than after the table
+        const size_t data_offset_offset = 24;
+        std::string misplaced = data;
+        uint64_t data_offset = 0;
+        memcpy(&data_offset, &misplaced[data_offset_offset], 8);
+        data_offset += 65536;
+        memcpy(&misplaced[data_offset_offset], &data_offset, 8);
+        misplaced.append(65536, '\0');
+        REQUIRE(!load_modified(misplaced));
+
+        std::remove(path.c_str());
+    };
+
+    SECTION("var_index")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "meterLeft = 1;" "\n"
+        "meterRight = 2;" "\n"
+        "peakMeter = 3;" "\n";
+
+        auto fx_handle = get_compiled_fx(jsfx);
+        auto fx = fx_handle.get();
+        ysfx_init(fx);
+
+        ysfx_real *left = ysfx_find_var(fx, "meterLeft");
+        REQUIRE(left);
+        REQUIRE(*left == 1);
+        REQUIRE(!ysfx_find_var(fx, "meterCenter"));
+
+        auto collect = [fx](const char *pattern, ysfx_var_search_mode_t mode) {
+            std::vector<std::string> names;
+            ysfx_search_vars(fx, pattern, mode, +[](const char *name, ysfx_real *, void *userdata) -> int {
+                ((std::vector<std::string> *)userdata)->push_back(name);
+                return 1;
+            }, &names);
+            return names;
+        };
+
+        REQUIRE((collect("METER", ysfx_var_search_prefix) == std::vector<std::string>{"meterLeft", "meterRight"}));
+        REQUIRE((collect("meter", ysfx_var_search_substring) == std::vector<std::string>{"meterLeft", "meterRight", "peakMeter"}));
+        REQUIRE((collect("right", ysfx_var_search_prefix).empty()));
+        REQUIRE((collect("", ysfx_var_search_prefix).size() >= 3));
+    };
+
+    SECTION("reinit_vars")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "was_x = x;" "\n"
+        "x = 5;" "\n"
+        "gfx_r += 1;" "\n"
+        "count += 1;" "\n"
+        "@block" "\n"
+        "late = 1;" "\n";
+
+        auto fx_handle = get_compiled_fx(jsfx);
+        auto fx = fx_handle.get();
+        ysfx_set_sample_rate(fx, 48000);
+
+        ysfx_init(fx);
+        REQUIRE(ysfx_read_var(fx, "x") == 5);
+        ysfx_init(fx);
+        REQUIRE(ysfx_read_var(fx, "was_x") == 0);
+        REQUIRE(ysfx_read_var(fx, "x") == 5);
+        REQUIRE(ysfx_read_var(fx, "count") == 1);
+        REQUIRE(ysfx_read_var(fx, "gfx_r") == 2);
+        REQUIRE(ysfx_read_var(fx, "srate") == 48000);
+
+        // variables registered after compilation are reset as well
+        EEL_F *added = NSEEL_VM_regvar(fx->vm.get(), "added_after_compile");
+        REQUIRE(added);
+        *added = 3;
+        ysfx_init(fx);
+        REQUIRE(*added == 0);
+        REQUIRE(ysfx_read_var(fx, "gfx_r") == 3);
+        REQUIRE(ysfx_read_var(fx, "srate") == 48000);
+    };
+
+    SECTION("strings_shared_with_dsp")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "strcpy(0, \"aaaaaaaa\");" "\n"
+        "@block" "\n"
+        "(n += 1) & 1 ? strcpy(0, \"bbbbbbbb\") : strcpy(0, \"aaaaaaaa\");" "\n";
+
+        auto fx_handle = get_compiled_fx(jsfx);
+        auto fx = fx_handle.get();
+
+        constexpr int NUM_FRAMES = 8;
+        ysfx_init(fx);
+        ysfx_set_block_size(fx, (uint32_t)NUM_FRAMES);
+
+        std::atomic<bool> done{false};
+        std::thread dsp([fx, &done]() {
+            static const double in0[NUM_FRAMES] = {};
+            static double out0[NUM_FRAMES] = {};
+            const double *const ins[] = { in0 };
+            double *const outs[] = { out0 };
+            for (int i = 0; i < 20000; ++i)
+                ysfx_process_double(fx, ins, outs, 1, 1, NUM_FRAMES);
+            done = true;
+        });
+
+        bool consistent = true;
+        std::string txt;
+        while (!done) {
+            ysfx_string_get(fx, 0, txt);
+            consistent = consistent && (txt == "aaaaaaaa" || txt == "bbbbbbbb");
+        }
+        dsp.join();
+
+        REQUIRE(consistent);
+        REQUIRE(ysfx_read_var(fx, "n") == 20000);
+    };
+
+    SECTION("atomics")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "x = 1;" "\n"
+        "r_add = atomic_add(x, 2);" "\n"
+        "r_ifeq_hit = atomic_setifequal(x, 3, 10);" "\n"
+        "r_ifeq_miss = atomic_setifequal(x, 3, 20);" "\n"
+        "y = 5;" "\n"
+        "r_exch = atomic_exch(x, y);" "\n"
+        "r_set = atomic_set(z, 7);" "\n"
+        "r_get = atomic_get(z);" "\n"
+        "atomic_add(mem[1001], 0.5);" "\n"
+        "r_mem = atomic_get(mem[1001]);" "\n";
+
+        auto fx_handle = get_compiled_fx(jsfx);
+        auto fx = fx_handle.get();
+        ysfx_init(fx);
+
+        REQUIRE(ysfx_read_var(fx, "r_add") == 3);
+        REQUIRE(ysfx_read_var(fx, "r_ifeq_hit") == 3);
+        REQUIRE(ysfx_read_var(fx, "r_ifeq_miss") == 10);
+        REQUIRE(ysfx_read_var(fx, "r_exch") == 5);
+        REQUIRE(ysfx_read_var(fx, "x") == 5);
+        REQUIRE(ysfx_read_var(fx, "y") == 10);
+        REQUIRE(ysfx_read_var(fx, "r_set") == 7);
+        REQUIRE(ysfx_read_var(fx, "r_get") == 7);
+        REQUIRE(ysfx_read_var(fx, "r_mem") == 0.5);
+    };
+
+    SECTION("atomics across threads")
+    {
+        const char *jsfx_add =
+        "desc:test" "\n"
+        "options:gmem=AtomicTester" "\n"
+        "out_pin:output" "\n"
+        "@block" "\n"
+        "loop(1000, atomic_add(gmem[0], 1));" "\n";
+
+        const char *jsfx_read =
+        "desc:test" "\n"
+        "options:gmem=AtomicTester" "\n"
+        "out_pin:output" "\n"
+        "@init" "\n"
+        "total = atomic_get(gmem[0]);" "\n";
+
+        const int num_threads = 4;
+        const int num_blocks = 1000;
+
+        std::vector<ysfx_u> adders;
+        for (int i = 0; i < num_threads; ++i) {
+            adders.push_back(get_compiled_fx(jsfx_add));
+            ysfx_init(adders.back().get());
+        }
+
+        // the increments of all threads go to the same cell, at the same time
+        std::atomic<int> ready{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < num_threads; ++i) {
+            ysfx_t *fx = adders[i].get();
+            threads.emplace_back([fx, &ready, num_threads, num_blocks]() {
+                ready.fetch_add(1);
+                while (ready.load() < num_threads)
+                    std::this_thread::yield();
+                for (int j = 0; j < num_blocks; ++j)
+                    ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+
+        auto read = get_compiled_fx(jsfx_read);
+        ysfx_init(read.get());
+        REQUIRE(ysfx_read_var(read.get(), "total") == num_threads * num_blocks * 1000);
+    };
+
+    SECTION("state generation")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "slider1:0<0,10,1>Mode" "\n"
+        "slider2:0<0,100,1>Other" "\n"
+        "@block" "\n"
+        "slider1 == 1 ? a += 1;" "\n"
+        "slider1 == 2 ? 12[0] += 1;" "\n"
+        "slider1 == 3 ? 20[0] += 1;" "\n"
+        "slider1 == 4 ? slider2 += 1;" "\n"
+        "slider1 == 5 ? b = 1;" "\n"
+        "slider1 == 6 ? c += 1;" "\n"
+        "@serialize" "\n"
+        "file_var(0, a);" "\n"
+        "file_var(0, b);" "\n"
+        "tmp = c;" "\n"
+        "file_var(0, tmp);" "\n"
+        "file_mem(0, 10, 4);" "\n";
+
+        auto fx_handle = get_compiled_fx(jsfx);
+        auto fx = fx_handle.get();
+        ysfx_init(fx);
+
+        auto save_with_mode = [fx](ysfx_real mode) -> uint64_t {
+            ysfx_slider_set_value(fx, 0, mode, true);
+            ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+            ysfx_state_u state{ysfx_save_state(fx)};
+            return ysfx_get_state_generation(fx);
+        };
+
+        // not saved yet, so it is always assumed to change
+        uint64_t gen = ysfx_get_state_generation(fx);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // the memory outside of the serialized data is not watched
+        gen = save_with_mode(3);
+        REQUIRE(ysfx_get_state_generation(fx) == gen);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_get_state_generation(fx) == gen);
+
+        // a serialized variable
+        gen = save_with_mode(1);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // a variable serialized through a temporary
+        gen = save_with_mode(6);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // serialized memory
+        gen = save_with_mode(2);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // a slider written by the code
+        gen = save_with_mode(4);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // a slider set by the host
+        gen = save_with_mode(0);
+        REQUIRE(ysfx_get_state_generation(fx) == gen);
+        ysfx_slider_set_value(fx, 1, 50, true);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // a change which another save has seen before the next poll
+        ysfx_slider_set_value(fx, 0, 5, true);
+        gen = ysfx_get_state_generation(fx);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        REQUIRE(ysfx_read_var(fx, "b") == 1);
+        ysfx_state_u state{ysfx_save_state(fx)};
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+
+        // and a save which has seen no change
+        gen = ysfx_get_state_generation(fx);
+        ysfx_process_double(fx, nullptr, nullptr, 0, 0, 0);
+        state.reset(ysfx_save_state(fx));
+        REQUIRE(ysfx_get_state_generation(fx) == gen);
+    };
+
+    SECTION("state generation with memory read by @serialize")
+    {
+        const char *jsfx =
+        "desc:test" "\n"
+        "out_pin:output" "\n"
+        "@serialize" "\n"
+        "tmp = 20[0];" "\n"
+        "file_var(0, tmp);" "\n";
+
+        auto fx_handle = get_compiled_fx(jsfx);
+        auto fx = fx_handle.get();
+        ysfx_init(fx);
+
+        // the memory is not watched, so it is always assumed to change
+        ysfx_state_u state{ysfx_save_state(fx)};
+        uint64_t gen = ysfx_get_state_generation(fx);
+        REQUIRE(ysfx_get_state_generation(fx) != gen);
+    };
 }
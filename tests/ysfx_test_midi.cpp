@@ -17,6 +17,7 @@
 
 #include "ysfx.h"
 #include "ysfx_test_utils.hpp"
+#include "ysfx_midi.hpp"
 #include <catch.hpp>
 #include <cstring>
 
@@ -404,5 +405,248 @@ TEST_CASE("midi input and output", "[midi]")
         REQUIRE(mem2[2] == 0x7f);
     }
 
+    SECTION("batch send and receive")
+    {
+        const char *text =
+            "desc:example" "\n"
+            "out_pin:output" "\n"
+            "@block" "\n"
+            "while (midirecv(offset, msg1, msg2, msg3)) (" "\n"
+            "  midisend(offset, msg1, msg2, msg3);" "\n"
+            ");" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+
+        const uint8_t syx[] = {0xf0, 1, 2, 3, 0xf7};
+        uint8_t notes[100][3];
+        ysfx_midi_event_t events[101];
+        for (uint32_t i = 0; i < 100; ++i) {
+            notes[i][0] = 0x90;
+            notes[i][1] = (uint8_t)i;
+            notes[i][2] = 0x40;
+            events[i].bus = 0;
+            events[i].offset = i;
+            events[i].size = 3;
+            events[i].data = notes[i];
+        }
+        events[100].bus = 0;
+        events[100].offset = 100;
+        events[100].size = sizeof(syx);
+        events[100].data = syx;
+
+        REQUIRE(ysfx_send_midi_batch(fx.get(), events, 101) == 101);
+
+        ysfx_process_float(fx.get(), nullptr, nullptr, 0, 0, 128);
+
+        ysfx_midi_event_t received[64];
+        uint32_t total = 0;
+        uint32_t count;
+        while ((count = ysfx_receive_midi_batch(fx.get(), received, 64)) > 0) {
+            for (uint32_t i = 0; i < count; ++i, ++total) {
+                REQUIRE(received[i].offset == total);
+                if (total < 100) {
+                    REQUIRE(received[i].size == 3);
+                    REQUIRE(received[i].data[1] == total);
+                }
+                else {
+                    REQUIRE(received[i].size == sizeof(syx));
+                    REQUIRE(memcmp(received[i].data, syx, sizeof(syx)) == 0);
+                }
+            }
+        }
+        REQUIRE(total == 101);
+    }
+
     // TODO test MIDI bus
 }
+
+TEST_CASE("midi buffer", "[midi]")
+{
+    SECTION("short and long messages")
+    {
+        ysfx_midi_buffer_t midi;
+        ysfx_midi_reserve(&midi, 1024, false);
+
+        const uint8_t note[] = {0x90, 60, 0x40};
+        const uint8_t pgm[] = {0xc0, 5};
+        const uint8_t syx[] = {0xf0, 1, 2, 3, 4, 0xf7};
+
+        ysfx_midi_event_t event;
+        event.bus = 1;
+        event.offset = 10;
+        event.size = sizeof(note);
+        event.data = note;
+        REQUIRE(ysfx_midi_push(&midi, &event));
+        event.bus = 2;
+        event.offset = 20;
+        event.size = sizeof(syx);
+        event.data = syx;
+        REQUIRE(ysfx_midi_push(&midi, &event));
+        event.bus = 1;
+        event.offset = 30;
+        event.size = sizeof(pgm);
+        event.data = pgm;
+        REQUIRE(ysfx_midi_push(&midi, &event));
+
+        REQUIRE(midi.events.size() == 3);
+        REQUIRE(midi.arena.size() == sizeof(syx));
+        REQUIRE(midi.used == 3 * sizeof(ysfx_midi_packed_t) + sizeof(syx));
+
+        REQUIRE(ysfx_midi_get_next(&midi, &event));
+        REQUIRE(event.bus == 1);
+        REQUIRE(event.offset == 10);
+        REQUIRE(event.size == 3);
+        REQUIRE(memcmp(event.data, note, 3) == 0);
+        REQUIRE(ysfx_midi_get_next(&midi, &event));
+        REQUIRE(event.bus == 2);
+        REQUIRE(event.offset == 20);
+        REQUIRE(event.size == sizeof(syx));
+        REQUIRE(memcmp(event.data, syx, sizeof(syx)) == 0);
+        REQUIRE(ysfx_midi_get_next(&midi, &event));
+        REQUIRE(event.bus == 1);
+        REQUIRE(event.offset == 30);
+        REQUIRE(event.size == 2);
+        REQUIRE(memcmp(event.data, pgm, 2) == 0);
+        REQUIRE(!ysfx_midi_get_next(&midi, &event));
+
+        REQUIRE(ysfx_midi_get_next_from_bus(&midi, 2, &event));
+        REQUIRE(event.offset == 20);
+        REQUIRE(!ysfx_midi_get_next_from_bus(&midi, 2, &event));
+        REQUIRE(ysfx_midi_get_next_from_bus(&midi, 1, &event));
+        REQUIRE(event.offset == 10);
+        REQUIRE(ysfx_midi_get_next_from_bus(&midi, 1, &event));
+        REQUIRE(event.offset == 30);
+        REQUIRE(!ysfx_midi_get_next_from_bus(&midi, 1, &event));
+    }
+
+    SECTION("incremental writer")
+    {
+        ysfx_midi_buffer_t midi;
+        ysfx_midi_reserve(&midi, 1024, false);
+
+        const uint8_t syx[] = {0xf0, 1, 2, 3, 4, 0xf7};
+        ysfx_midi_push_t mp;
+        REQUIRE(ysfx_midi_push_begin(&midi, 0, 5, &mp));
+        for (uint8_t byte : syx)
+            REQUIRE(ysfx_midi_push_data(&mp, &byte, 1));
+        REQUIRE(ysfx_midi_push_end(&mp));
+
+        // a short message written incrementally ends up inline
+        const uint8_t note[] = {0x80, 60, 0};
+        REQUIRE(ysfx_midi_push_begin(&midi, 0, 6, &mp));
+        REQUIRE(ysfx_midi_push_data(&mp, note, 3));
+        REQUIRE(ysfx_midi_push_end(&mp));
+
+        REQUIRE(midi.arena.size() == sizeof(syx));
+
+        ysfx_midi_event_t events[4];
+        REQUIRE(ysfx_midi_get_batch(&midi, events, 4) == 2);
+        REQUIRE(events[0].offset == 5);
+        REQUIRE(events[0].size == sizeof(syx));
+        REQUIRE(memcmp(events[0].data, syx, sizeof(syx)) == 0);
+        REQUIRE(events[1].offset == 6);
+        REQUIRE(events[1].size == 3);
+        REQUIRE(memcmp(events[1].data, note, 3) == 0);
+        REQUIRE(ysfx_midi_get_batch(&midi, events, 4) == 0);
+
+        ysfx_midi_rewind(&midi);
+        size_t count = 0;
+        const ysfx_midi_packed_t *span = ysfx_midi_get_span(&midi, &count);
+        REQUIRE(count == 2);
+        REQUIRE(span[1].offset == 6);
+        ysfx_midi_get_span(&midi, &count);
+        REQUIRE(count == 0);
+    }
+
+    SECTION("capacity")
+    {
+        ysfx_midi_buffer_t midi;
+        ysfx_midi_reserve(&midi, 4 * sizeof(ysfx_midi_packed_t), false);
+
+        const uint8_t note[] = {0x90, 60, 0x40};
+        const uint8_t syx[] = {0xf0, 1, 2, 3, 4, 0xf7};
+
+        ysfx_midi_event_t event;
+        event.bus = 0;
+        event.offset = 0;
+        event.size = sizeof(syx);
+        event.data = syx;
+        REQUIRE(ysfx_midi_push(&midi, &event));
+
+        // 14 bytes used, room left for 2 short messages
+        event.size = sizeof(note);
+        event.data = note;
+        REQUIRE(ysfx_midi_push(&midi, &event));
+        REQUIRE(ysfx_midi_push(&midi, &event));
+        REQUIRE(!ysfx_midi_push(&midi, &event));
+
+        ysfx_midi_clear(&midi);
+        for (uint32_t i = 0; i < 4; ++i)
+            REQUIRE(ysfx_midi_push(&midi, &event));
+        REQUIRE(!ysfx_midi_push(&midi, &event));
+    }
+
+    SECTION("batch with rejected events")
+    {
+        ysfx_midi_buffer_t midi;
+        ysfx_midi_reserve(&midi, 3 * sizeof(ysfx_midi_packed_t), false);
+
+        const uint8_t note[] = {0x90, 60, 0x40};
+        const uint8_t syx[] = {0xf0, 1, 2, 3, 4, 0xf7};
+
+        ysfx_midi_event_t events[5];
+        for (uint32_t i = 0; i < 5; ++i) {
+            events[i].bus = 0;
+            events[i].offset = i;
+            events[i].size = sizeof(note);
+            events[i].data = note;
+        }
+        // an invalid bus, and a message too long for the room left
+        events[1].bus = ysfx_max_midi_buses;
+        events[3].size = sizeof(syx);
+        events[3].data = syx;
+
+        // the rejected events are skipped, and the rest fills the capacity
+        REQUIRE(ysfx_midi_push_batch(&midi, events, 5) == 3);
+
+        ysfx_midi_event_t received[5];
+        REQUIRE(ysfx_midi_get_batch(&midi, received, 5) == 3);
+        REQUIRE(received[0].offset == 0);
+        REQUIRE(received[1].offset == 2);
+        REQUIRE(received[2].offset == 4);
+    }
+
+    SECTION("batch growth")
+    {
+        ysfx_midi_buffer_t midi;
+        ysfx_midi_reserve(&midi, 0, true);
+
+        const uint8_t note[] = {0x90, 60, 0x40};
+        ysfx_midi_event_t events[4];
+        for (uint32_t i = 0; i < 4; ++i) {
+            events[i].bus = 0;
+            events[i].offset = i;
+            events[i].size = sizeof(note);
+            events[i].data = note;
+        }
+
+        uint32_t reallocations = 0;
+        size_t capacity = midi.events.capacity();
+        for (uint32_t i = 0; i < 256; ++i) {
+            REQUIRE(ysfx_midi_push_batch(&midi, events, 4) == 4);
+            if (midi.events.capacity() != capacity) {
+                capacity = midi.events.capacity();
+                ++reallocations;
+            }
+        }
+        REQUIRE(midi.events.size() == 1024);
+        REQUIRE(reallocations <= 10);
+    }
+}
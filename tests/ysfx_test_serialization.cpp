@@ -251,4 +251,47 @@ TEST_CASE("save and load", "[serialization]")
         REQUIRE(ysfx::unpack_f32le(&state->data[3 * sizeof(float)]) == 300);
         REQUIRE(ysfx::unpack_f32le(&state->data[4 * sizeof(float)]) == 400);
     };
+
+    SECTION("large file_mem")
+    {
+        // the memory spans several blocks, some of which are never allocated
+        const char *text =
+            "desc:example" "\n"
+            "out_pin:output" "\n"
+            "@init" "\n"
+            "i = 0; loop(70000, i[0] = i + 0.5; i += 1);" "\n"
+            "200000[0] = 7;" "\n"
+            "@serialize" "\n"
+            "count = file_mem(0, 0, 300000);" "\n"
+            "extra = file_var(0, last);" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text);
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        ysfx_state_u state{ysfx_save_state(fx.get())};
+        REQUIRE(state);
+        REQUIRE(state->data_size == 300001 * sizeof(float));
+        REQUIRE(ysfx::unpack_f32le(&state->data[0]) == 0.5);
+        REQUIRE(ysfx::unpack_f32le(&state->data[69999 * sizeof(float)]) == 69999.5);
+        REQUIRE(ysfx::unpack_f32le(&state->data[70000 * sizeof(float)]) == 0);
+        REQUIRE(ysfx::unpack_f32le(&state->data[200000 * sizeof(float)]) == 7);
+        REQUIRE(ysfx::unpack_f32le(&state->data[299999 * sizeof(float)]) == 0);
+
+        // loading a truncated state reads as much as there is
+        ysfx::pack_f32le(-1, &state->data[100 * sizeof(float)]);
+        state->data_size = 1000 * sizeof(float) + 2;
+        REQUIRE(ysfx_load_state(fx.get(), state.get()));
+        REQUIRE(ysfx_read_var(fx.get(), "count") == 1000);
+        REQUIRE(ysfx_read_var(fx.get(), "extra") == 0);
+        REQUIRE(ysfx_read_vmem_single(fx.get(), 100) == -1);
+        REQUIRE(ysfx_read_vmem_single(fx.get(), 999) == 999.5);
+        REQUIRE(ysfx_read_vmem_single(fx.get(), 1000) == 1000.5);
+    };
 }
@@ -83,6 +83,33 @@ TEST_CASE("slider manipulation", "[sliders]")
         REQUIRE(ysfx_slider_get_value(fx.get(), 1) == 3);
     }
 
+    SECTION("many slider aliases")
+    {
+        std::string text =
+            "desc:example" "\n"
+            "out_pin:output" "\n";
+        for (int i = 0; i < ysfx_max_sliders; ++i)
+            text += "slider" + std::to_string(i + 1) + ":Param" + std::to_string(i) + "=0<0,1000,1>param" "\n";
+        text += "@init" "\n";
+        for (int i = 0; i < ysfx_max_sliders; ++i)
+            text += "PARAM" + std::to_string(i) + "=" + std::to_string(i) + ";" "\n";
+        text += "params=1;" "\n";
+
+        scoped_new_dir dir_fx("${root}/Effects");
+        scoped_new_txt file_main("${root}/Effects/example.jsfx", text.c_str());
+
+        ysfx_config_u config{ysfx_config_new()};
+        ysfx_u fx{ysfx_new(config.get())};
+
+        REQUIRE(ysfx_load_file(fx.get(), file_main.m_path.c_str(), 0));
+        REQUIRE(ysfx_compile(fx.get(), 0));
+        ysfx_init(fx.get());
+
+        for (int i = 0; i < ysfx_max_sliders; ++i)
+            REQUIRE(ysfx_slider_get_value(fx.get(), (uint32_t)i) == i);
+        REQUIRE(ysfx_read_var(fx.get(), "params") == 1);
+    }
+
     SECTION("slider visibility")
     {
         const char *text =
@@ -0,0 +1,218 @@
+// Copyright 2021 Jean Pierre Cimalando
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "ysfx.h"
+#include "utility/undo_history.h"
+#include <catch.hpp>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> random_bytes(size_t size, uint64_t seed)
+{
+    std::mt19937_64 prng{seed};
+    std::vector<uint8_t> data(size);
+    for (uint8_t &byte : data)
+        byte = (uint8_t)std::uniform_int_distribution<int>{0, 255}(prng);
+    return data;
+}
+
+std::vector<uint8_t> round_trip(const std::vector<uint8_t> &base, const std::vector<uint8_t> &target)
+{
+    std::vector<uint8_t> delta = encodeBinaryDelta(base.data(), base.size(), target.data(), target.size());
+    std::vector<uint8_t> result;
+    REQUIRE(applyBinaryDelta(base.data(), base.size(), delta.data(), delta.size(), result));
+    return result;
+}
+
+struct test_state {
+    std::vector<ysfx_state_slider_t> sliders;
+    std::vector<uint8_t> data;
+
+    ysfx_state_t view()
+    {
+        ysfx_state_t state{};
+        state.sliders = sliders.data();
+        state.slider_count = (uint32_t)sliders.size();
+        state.data = data.data();
+        state.data_size = data.size();
+        return state;
+    }
+};
+
+} // namespace
+
+TEST_CASE("binary delta", "[undo]")
+{
+    const std::vector<uint8_t> base = random_bytes(10000, 1);
+
+    SECTION("identical")
+    {
+        std::vector<uint8_t> delta = encodeBinaryDelta(base.data(), base.size(), base.data(), base.size());
+        REQUIRE(delta.size() < 16);
+        REQUIRE(round_trip(base, base) == base);
+    }
+
+    SECTION("in-place edits")
+    {
+        std::vector<uint8_t> target = base;
+        target[0] ^= 0xff;
+        target[5000] ^= 0xff;
+        target[9999] ^= 0xff;
+        std::vector<uint8_t> delta = encodeBinaryDelta(base.data(), base.size(), target.data(), target.size());
+        REQUIRE(delta.size() < 500);
+        REQUIRE(round_trip(base, target) == target);
+    }
+
+    SECTION("insertions and removals")
+    {
+        std::vector<uint8_t> target = base;
+        std::vector<uint8_t> inserted = random_bytes(300, 2);
+        target.insert(target.begin() + 1234, inserted.begin(), inserted.end());
+        target.erase(target.begin() + 7000, target.begin() + 7100);
+        std::vector<uint8_t> delta = encodeBinaryDelta(base.data(), base.size(), target.data(), target.size());
+        REQUIRE(delta.size() < 1000);
+        REQUIRE(round_trip(base, target) == target);
+    }
+
+    SECTION("truncation and growth")
+    {
+        std::vector<uint8_t> shorter(base.begin(), base.begin() + 4321);
+        REQUIRE(round_trip(base, shorter) == shorter);
+        std::vector<uint8_t> longer = base;
+        longer.resize(15000, 0);
+        REQUIRE(round_trip(base, longer) == longer);
+    }
+
+    SECTION("small and empty")
+    {
+        std::vector<uint8_t> empty;
+        std::vector<uint8_t> small{1, 2, 3};
+        REQUIRE(round_trip(empty, small) == small);
+        REQUIRE(round_trip(small, empty) == empty);
+        REQUIRE(round_trip(base, empty) == empty);
+        REQUIRE(round_trip(empty, base) == base);
+    }
+
+    SECTION("malformed")
+    {
+        std::vector<uint8_t> target = base;
+        target[5000] ^= 0xff;
+        std::vector<uint8_t> delta = encodeBinaryDelta(base.data(), base.size(), target.data(), target.size());
+        std::vector<uint8_t> result;
+
+        // truncated anywhere
+        for (size_t size = 0; size < delta.size(); ++size)
+            REQUIRE(!applyBinaryDelta(base.data(), base.size(), delta.data(), size, result));
+
+        // against a shorter base, the copies are out of range
+        REQUIRE(!applyBinaryDelta(base.data(), 1000, delta.data(), delta.size(), result));
+
+        // a wrong target size
+        std::vector<uint8_t> wrong_size = delta;
+        wrong_size[0] ^= 1;
+        REQUIRE(!applyBinaryDelta(base.data(), base.size(), wrong_size.data(), wrong_size.size(), result));
+
+        // an unterminated integer
+        const uint8_t unterminated[] = {0x80, 0x80, 0x80};
+        REQUIRE(!applyBinaryDelta(base.data(), base.size(), unterminated, sizeof(unterminated), result));
+
+        // a literal longer than the delta
+        const uint8_t long_literal[] = {4, 8, 1, 2};
+        REQUIRE(!applyBinaryDelta(base.data(), base.size(), long_literal, sizeof(long_literal), result));
+
+        // a huge target size, which must not be allocated up front
+        const uint8_t huge_size[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f, 4, 1, 2};
+        std::vector<uint8_t> huge_result;
+        REQUIRE(!applyBinaryDelta(base.data(), base.size(), huge_size, sizeof(huge_size), huge_result));
+        REQUIRE(huge_result.capacity() <= base.size() + sizeof(huge_size));
+    }
+}
+
+TEST_CASE("undo history", "[undo]")
+{
+    // a long history, with deltas and periodic full copies
+    std::vector<test_state> states(40);
+    std::vector<uint8_t> data = random_bytes(5000, 3);
+    for (size_t i = 0; i < states.size(); ++i) {
+        data[(i * 997) % data.size()] ^= 0xff;
+        if (i % 7 == 3)
+            data.resize(data.size() + 100, (uint8_t)i);
+        states[i].sliders.resize(2);
+        states[i].sliders[0].index = 0;
+        states[i].sliders[0].value = (ysfx_real)i;
+        states[i].sliders[1].index = 5;
+        states[i].sliders[1].value = 0.5;
+        states[i].data = data;
+    }
+
+    UndoHistory history;
+    for (test_state &state : states) {
+        ysfx_state_t view = state.view();
+        history.pushBack(view, UndoHistory::hashData(view));
+    }
+    REQUIRE(history.size() == states.size());
+
+    auto check = [&](size_t index, const test_state &expected) {
+        ysfx_state_u state = history.get(index);
+        REQUIRE(state);
+        REQUIRE(state->slider_count == expected.sliders.size());
+        for (uint32_t i = 0; i < state->slider_count; ++i) {
+            REQUIRE(state->sliders[i].index == expected.sliders[i].index);
+            REQUIRE(state->sliders[i].value == expected.sliders[i].value);
+        }
+        REQUIRE(std::vector<uint8_t>(state->data, state->data + state->data_size) == expected.data);
+    };
+
+    SECTION("rebuild")
+    {
+        // backwards, as by undo, then in random order
+        for (size_t i = states.size(); i-- > 0; )
+            check(i, states[i]);
+        std::mt19937_64 prng;
+        for (int n = 0; n < 100; ++n) {
+            size_t i = std::uniform_int_distribution<size_t>{0, states.size() - 1}(prng);
+            check(i, states[i]);
+        }
+    }
+
+    SECTION("equality")
+    {
+        for (size_t i = 0; i < states.size(); ++i) {
+            ysfx_state_t view = states[i].view();
+            uint64_t hash = UndoHistory::hashData(view);
+            REQUIRE(history.isEqual(i, view, hash));
+            REQUIRE(!history.isEqual((i + 1) % states.size(), view, hash));
+        }
+    }
+
+    SECTION("pop and truncate")
+    {
+        for (int n = 0; n < 5; ++n)
+            history.popFront();
+        history.truncate(20);
+        REQUIRE(history.size() == 20);
+        for (size_t i = 0; i < history.size(); ++i)
+            check(i, states[i + 5]);
+
+        // the next state is a delta against the last remaining one
+        ysfx_state_t view = states[39].view();
+        history.pushBack(view, UndoHistory::hashData(view));
+        check(20, states[39]);
+        check(19, states[24]);
+    }
+}
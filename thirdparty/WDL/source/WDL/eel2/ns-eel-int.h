@@ -240,6 +240,7 @@ typedef struct _compileContext
     int maxblocks;
     double closefact;
     EEL_F *blocks[NSEEL_RAM_BLOCKS];
+    int usedblocks; // number of non-NULL blocks[], must follow blocks[] (see __NSEEL_RAMAlloc)
   } *ram_state; // allocated from blocks with 16 byte alignment
 
   void *gram_blocks;
@@ -77,6 +77,7 @@ void NSEEL_VM_freeRAMIfCodeRequested(NSEEL_VMCTX ctx) // check to see if our fre
               else NSEEL_RAM_memused_errors++;
                 free(blocks[x]);
                 blocks[x]=0;
+                c->ram_state->usedblocks--;
             }
           }
           pos+=NSEEL_RAM_ITEMSPERBLOCK;
@@ -154,7 +155,11 @@ EEL_F * NSEEL_CGEN_CALL  __NSEEL_RAMAlloc(EEL_F **pblocks, unsigned int w)
         if (!NSEEL_RAM_limitmem || NSEEL_RAM_memused+msize < NSEEL_RAM_limitmem) 
         {
           p=pblocks[whichblock]=(EEL_F *)calloc(sizeof(EEL_F),NSEEL_RAM_ITEMSPERBLOCK);
-          if (p) NSEEL_RAM_memused+=msize;
+          if (p)
+          {
+            NSEEL_RAM_memused+=msize;
+            ((int *)(pblocks+NSEEL_RAM_BLOCKS))[0]++; // ram_state->usedblocks
+          }
         }
       }
       NSEEL_HOSTSTUB_LeaveMutex();
@@ -525,6 +530,7 @@ void NSEEL_VM_freeRAM(NSEEL_VMCTX ctx)
         blocks[x]=0;
       }
     }
+    c->ram_state->usedblocks=0;
     c->ram_state->needfree=0; // no need to free anymore
   }
 }
@@ -560,6 +566,12 @@ EEL_F *NSEEL_VM_getramptr(NSEEL_VMCTX ctx, unsigned int offs, int *validCount)
   return d;
 }
 
+int NSEEL_VM_getramusedblocks(NSEEL_VMCTX ctx)
+{
+  compileContext *cc = (compileContext *)ctx;
+  return cc ? cc->ram_state->usedblocks : 0;
+}
+
 EEL_F *NSEEL_VM_getramptr_noalloc(NSEEL_VMCTX ctx, unsigned int offs, int *validCount)
 {
   EEL_F *d;
@@ -24,7 +24,15 @@
   #define SWELL_GDI_DEBUG
 #endif
 
-static WDL_Mutex *m_ctxpool_mutex;
+// the pools are used by the threads which draw concurrently, so the mutex
+// is created on first use in a way which is safe for them; it is leaked, so
+// that it outlives the objects which are released during static destruction
+static WDL_Mutex *SWELL_GDP_Mutex()
+{
+  static WDL_Mutex *m = new WDL_Mutex;
+  return m;
+}
+#define m_ctxpool_mutex (SWELL_GDP_Mutex())
 #ifdef SWELL_GDI_DEBUG
   #include "../ptrlist.h"
   static WDL_PtrList<HDC__> *m_ctxpool_debug;
@@ -40,7 +48,6 @@ static WDL_Mutex *m_ctxpool_mutex;
 
 HDC__ *SWELL_GDP_CTX_NEW()
 {
-  if (!m_ctxpool_mutex) m_ctxpool_mutex=new WDL_Mutex;
   
   HDC__ *p=NULL;
 #ifdef SWELL_GDI_DEBUG
@@ -54,17 +61,14 @@ HDC__ *SWELL_GDP_CTX_NEW()
   }
   m_ctxpool_mutex->Leave();
 #else
-  if (m_ctxpool)
-  {
-    m_ctxpool_mutex->Enter();
-    if ((p=m_ctxpool))
-    { 
-      m_ctxpool=p->_next;
-      m_ctxpool_size--;
-      memset(p,0,sizeof(*p));
-    }
-    m_ctxpool_mutex->Leave();
+  m_ctxpool_mutex->Enter();
+  if ((p=m_ctxpool))
+  { 
+    m_ctxpool=p->_next;
+    m_ctxpool_size--;
+    memset(p,0,sizeof(*p));
   }
+  m_ctxpool_mutex->Leave();
 #endif
   if (!p) 
   {
@@ -75,8 +79,6 @@ HDC__ *SWELL_GDP_CTX_NEW()
 }
 static void SWELL_GDP_CTX_DELETE(HDC__ *p)
 {
-  if (!m_ctxpool_mutex) m_ctxpool_mutex=new WDL_Mutex;
-
   if (WDL_NOT_NORMALLY(!p || p->_infreelist)) return;
 
   memset(p,0,sizeof(*p));
@@ -88,25 +90,22 @@ static void SWELL_GDP_CTX_DELETE(HDC__ *p)
   m_ctxpool_debug->Add(p);
   m_ctxpool_mutex->Leave();
 #else
+  m_ctxpool_mutex->Enter();
   if (m_ctxpool_size<100)
   {
-    m_ctxpool_mutex->Enter();
     p->_infreelist=true;
     p->_next = m_ctxpool;
     m_ctxpool = p;
     m_ctxpool_size++;
-    m_ctxpool_mutex->Leave();
+    p=NULL;
   }
-  else 
-  {
+  m_ctxpool_mutex->Leave();
   //  printf("free ctx\n");
-    free(p);
-  }
+  if (p) free(p);
 #endif
 }
 static HGDIOBJ__ *GDP_OBJECT_NEW()
 {
-  if (!m_ctxpool_mutex) m_ctxpool_mutex=new WDL_Mutex;
   HGDIOBJ__ *p=NULL;
 #ifdef SWELL_GDI_DEBUG
   m_ctxpool_mutex->Enter();
@@ -119,17 +118,14 @@ static HGDIOBJ__ *GDP_OBJECT_NEW()
   }
   m_ctxpool_mutex->Leave();
 #else
-  if (m_objpool)
+  m_ctxpool_mutex->Enter();
+  if ((p=m_objpool))
   {
-    m_ctxpool_mutex->Enter();
-    if ((p=m_objpool))
-    {
-      m_objpool = p->_next;
-      m_objpool_size--;
-      memset(p,0,sizeof(*p));
-    }
-    m_ctxpool_mutex->Leave();
+    m_objpool = p->_next;
+    m_objpool_size--;
+    memset(p,0,sizeof(*p));
   }
+  m_ctxpool_mutex->Leave();
 #endif
   if (!p) 
   {
@@ -150,7 +146,6 @@ static bool HGDIOBJ_VALID(HGDIOBJ__ *p, int reqType=0)
 
 static void GDP_OBJECT_DELETE(HGDIOBJ__ *p)
 {
-  if (!m_ctxpool_mutex) m_ctxpool_mutex=new WDL_Mutex;
   if (WDL_NOT_NORMALLY(!p) || !HGDIOBJ_VALID(p)) return;
 
   memset(p,0,sizeof(*p));
@@ -161,20 +156,18 @@ static void GDP_OBJECT_DELETE(HGDIOBJ__ *p)
   m_objpool_debug->Add(p);
   m_ctxpool_mutex->Leave();
 #else
+  m_ctxpool_mutex->Enter();
   if (m_objpool_size<200)
   {
-    m_ctxpool_mutex->Enter();
     p->_infreelist = true;
     p->_next = m_objpool;
     m_objpool = p;
     m_objpool_size++;
-    m_ctxpool_mutex->Leave();
-  }
-  else
-  {
-    //    printf("free obj\n");
-    free(p);
+    p=NULL;
   }
+  m_ctxpool_mutex->Leave();
+  //    printf("free obj\n");
+  if (p) free(p);
 #endif
 }
 
@@ -212,9 +205,6 @@ class _swellGdiUnloader
          free(t);
        }
      }
-
-     delete m_ctxpool_mutex;
-     m_ctxpool_mutex=NULL;
   }
 };
 
@@ -16,18 +16,27 @@
 //
 
 #include "ysfx.h"
+#if !defined(YSFX_NO_GFX)
+#   define WDL_NO_DEFINE_MINMAX
+#   include "WDL/lice/lice.h"
+#endif
 #include <getopt.h>
 #include <vector>
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 namespace kro = std::chrono;
 
 struct {
     const char *input_file = nullptr;
     bool no_gfx = false;
     bool no_serialize = false;
+    const char *render_gfx = nullptr;
 } args;
 
 void print_help()
@@ -35,7 +44,19 @@ void print_help()
     fprintf(stderr, "Usage: ysfx_tool [option]... <file.jsfx>\n"
         "Options:\n"
         "\t" "--no-gfx          Do not compile the @gfx section" "\n"
-        "\t" "--no-serialize    Do not compile the @serialize section" "\n");
+        "\t" "--no-serialize    Do not compile the @serialize section" "\n"
+        "\t" "--render-gfx=FILE Run @gfx headless, following the script in FILE" "\n"
+        "\n"
+        "Each line of a @gfx script is one of these commands:" "\n"
+        "\t" "size W H          Resize the frame buffer, by default the @gfx size" "\n"
+        "\t" "frame [N]         Run @gfx N times, 1 by default, and time it" "\n"
+        "\t" "mods [MODS]       Hold the modifiers, such as ctrl+shift, or none" "\n"
+        "\t" "mouse X Y [BTNS]  Move the mouse, holding the buttons among l, m, r" "\n"
+        "\t" "wheel V [H]       Turn the mouse wheel, by steps" "\n"
+        "\t" "key KEY           Press and release a character, or a named key" "\n"
+        "\t" "slider N VALUE    Set the value of slider N, starting from 0" "\n"
+        "\t" "save FILE         Write the frame buffer to a PNG file" "\n"
+        "Empty lines, and lines starting with '#', are ignored." "\n");
 }
 
 void process_args(int argc, char *argv[])
@@ -44,6 +65,7 @@ void process_args(int argc, char *argv[])
         {"help", 0, nullptr, 'h'},
         {"no-gfx", 0, nullptr, 'G'},
         {"no-serialize", 0, nullptr, 'S'},
+        {"render-gfx", 1, nullptr, 'R'},
         {},
     };
 
@@ -63,6 +85,9 @@ void process_args(int argc, char *argv[])
         case 'S':
             args.no_serialize = true;
             break;
+        case 'R':
+            args.render_gfx = optarg;
+            break;
         default:
             exit(1);
         }
@@ -164,6 +189,241 @@ void dump_header_info(ysfx_t *fx)
     }
 }
 
+#if !defined(YSFX_NO_GFX)
+struct gfx_renderer {
+    ysfx_t *fx = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> pixels;
+    uint32_t mods = 0;
+    int32_t mouse_x = 0;
+    int32_t mouse_y = 0;
+    uint32_t buttons = 0;
+    // the duration of each frame, in seconds
+    std::vector<double> frame_times;
+
+    void resize(uint32_t w, uint32_t h)
+    {
+        width = w;
+        height = h;
+        pixels.assign((size_t)w * h, 0);
+
+        ysfx_gfx_config_t gc{};
+        gc.pixel_width = w;
+        gc.pixel_height = h;
+        gc.pixels = (uint8_t *)pixels.data();
+        gc.scale_factor = 1.0;
+        ysfx_gfx_setup(fx, &gc);
+    }
+
+    void run_frame()
+    {
+        kro::steady_clock::time_point t1 = kro::steady_clock::now();
+        ysfx_gfx_run(fx);
+        kro::steady_clock::time_point t2 = kro::steady_clock::now();
+        frame_times.push_back(kro::duration<double>(t2 - t1).count());
+    }
+
+    bool save(const char *path)
+    {
+        // the pixels are in LICE format already; the alpha channel is not
+        // meaningful, the host displays them opaque
+        LICE_WrapperBitmap bm{(LICE_pixel *)pixels.data(), (int)width, (int)height, (int)width, false};
+        return LICE_WritePNG(path, &bm, false);
+    }
+};
+
+static bool parse_gfx_mods(const std::string &text, uint32_t &mods)
+{
+    mods = 0;
+    if (text == "none")
+        return true;
+
+    std::istringstream in(text);
+    for (std::string mod; std::getline(in, mod, '+');) {
+        if (mod == "shift")
+            mods |= ysfx_mod_shift;
+        else if (mod == "ctrl")
+            mods |= ysfx_mod_ctrl;
+        else if (mod == "alt")
+            mods |= ysfx_mod_alt;
+        else if (mod == "super")
+            mods |= ysfx_mod_super;
+        else
+            return false;
+    }
+    return true;
+}
+
+static bool parse_gfx_key(const std::string &text, uint32_t &key)
+{
+    static const struct { const char *name; uint32_t key; } names[] = {
+        {"backspace", ysfx_key_backspace}, {"tab", '\t'}, {"enter", '\r'},
+        {"escape", ysfx_key_escape}, {"space", ' '}, {"delete", ysfx_key_delete},
+        {"left", ysfx_key_left}, {"up", ysfx_key_up}, {"right", ysfx_key_right},
+        {"down", ysfx_key_down}, {"page_up", ysfx_key_page_up}, {"page_down", ysfx_key_page_down},
+        {"home", ysfx_key_home}, {"end", ysfx_key_end}, {"insert", ysfx_key_insert},
+    };
+
+    if (text.size() == 1) {
+        key = (uint8_t)text[0];
+        return true;
+    }
+    for (const auto &name : names) {
+        if (text == name.name) {
+            key = name.key;
+            return true;
+        }
+    }
+    unsigned fn = 0;
+    char extra = 0;
+    if (sscanf(text.c_str(), "f%u%c", &fn, &extra) == 1 && fn >= 1 && fn <= 12) {
+        key = ysfx_key_f1 + (fn - 1);
+        return true;
+    }
+    return false;
+}
+
+static void print_frame_times(std::vector<double> times)
+{
+    printf("Frames: %u\n", (uint32_t)times.size());
+    if (times.empty())
+        return;
+
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (double t : times)
+        total += t;
+    auto percentile = [&](double p) -> double {
+        return times[std::min(times.size() - 1, (size_t)(p * times.size()))];
+    };
+
+    printf("Total: %.3f ms\n", 1e3 * total);
+    printf("Mean: %.3f ms\n", 1e3 * total / times.size());
+    printf("Minimum: %.3f ms\n", 1e3 * times.front());
+    printf("Median: %.3f ms\n", 1e3 * percentile(0.5));
+    printf("95th percentile: %.3f ms\n", 1e3 * percentile(0.95));
+    printf("Maximum: %.3f ms\n", 1e3 * times.back());
+}
+
+bool render_gfx(ysfx_t *fx)
+{
+    printf("\n" "--- @gfx rendering ---" "\n\n");
+
+    if (!ysfx_has_section(fx, ysfx_section_gfx)) {
+        fprintf(stderr, "The effect does not have a @gfx section.\n");
+        return false;
+    }
+
+    std::ifstream script(args.render_gfx);
+    if (!script) {
+        fprintf(stderr, "Cannot open the script: %s\n", args.render_gfx);
+        return false;
+    }
+
+    ysfx_init(fx);
+
+    gfx_renderer renderer;
+    renderer.fx = fx;
+
+    uint32_t dim[2] = {};
+    ysfx_get_gfx_dim(fx, dim);
+    renderer.resize(dim[0] ? dim[0] : 640, dim[1] ? dim[1] : 480);
+
+    uint32_t lineno = 0;
+    for (std::string line; std::getline(script, line);) {
+        ++lineno;
+
+        std::istringstream in(line);
+        std::string command;
+        if (!(in >> command) || command[0] == '#')
+            continue;
+
+        bool ok = true;
+        if (command == "size") {
+            uint32_t w = 0, h = 0;
+            ok = (in >> w >> h) && w > 0 && h > 0;
+            if (ok)
+                renderer.resize(w, h);
+        }
+        else if (command == "frame") {
+            // the count is optional, but must be a number if it is given
+            uint32_t count = 1;
+            if (!(in >> std::ws).eof())
+                ok = (bool)(in >> count);
+            for (uint32_t i = 0; ok && i < count; ++i)
+                renderer.run_frame();
+        }
+        else if (command == "mods") {
+            std::string mods = "none";
+            in >> mods;
+            ok = parse_gfx_mods(mods, renderer.mods);
+        }
+        else if (command == "mouse") {
+            std::string btns;
+            ok = (bool)(in >> renderer.mouse_x >> renderer.mouse_y);
+            in >> btns;
+            renderer.buttons = 0;
+            for (char c : btns) {
+                if (c == 'l')
+                    renderer.buttons |= ysfx_button_left;
+                else if (c == 'm')
+                    renderer.buttons |= ysfx_button_middle;
+                else if (c == 'r')
+                    renderer.buttons |= ysfx_button_right;
+                else
+                    ok = false;
+            }
+            if (ok)
+                ysfx_gfx_update_mouse(fx, renderer.mods, renderer.mouse_x, renderer.mouse_y, renderer.buttons, 0, 0);
+        }
+        else if (command == "wheel") {
+            ysfx_real wheel = 0, hwheel = 0;
+            ok = (bool)(in >> wheel);
+            in >> hwheel;
+            if (ok)
+                ysfx_gfx_update_mouse(fx, renderer.mods, renderer.mouse_x, renderer.mouse_y, renderer.buttons, wheel, hwheel);
+        }
+        else if (command == "key") {
+            std::string name;
+            uint32_t key = 0;
+            ok = (in >> name) && parse_gfx_key(name, key);
+            if (ok) {
+                ysfx_gfx_add_key(fx, renderer.mods, key, true);
+                ysfx_gfx_add_key(fx, renderer.mods, key, false);
+            }
+        }
+        else if (command == "slider") {
+            uint32_t index = 0;
+            ysfx_real value = 0;
+            ok = (in >> index >> value) && ysfx_slider_exists(fx, index);
+            if (ok)
+                ysfx_slider_set_value(fx, index, value, true);
+        }
+        else if (command == "save") {
+            std::string path;
+            ok = (bool)(in >> path);
+            if (ok && !renderer.save(path.c_str())) {
+                fprintf(stderr, "Cannot write the image: %s\n", path.c_str());
+                return false;
+            }
+            if (ok)
+                printf("Saved: %s\n", path.c_str());
+        }
+        else
+            ok = false;
+
+        if (!ok) {
+            fprintf(stderr, "%s:%u: invalid command: %s\n", args.render_gfx, lineno, line.c_str());
+            return false;
+        }
+    }
+
+    print_frame_times(renderer.frame_times);
+    return true;
+}
+#endif
+
 bool process_jsfx()
 {
     ysfx_config_u config{ysfx_config_new()};
@@ -203,6 +463,20 @@ bool process_jsfx()
     t2 = kro::steady_clock::now();
     printf("Elapsed: %.3f ms\n", 1e3 * kro::duration<double>(t2 - t1).count());
 
+    if (args.render_gfx) {
+#if !defined(YSFX_NO_GFX)
+        if (args.no_gfx) {
+            fprintf(stderr, "Rendering requires the @gfx section to be compiled.\n");
+            return false;
+        }
+        if (!render_gfx(fx.get()))
+            return false;
+#else
+        fprintf(stderr, "This build does not support graphics.\n");
+        return false;
+#endif
+    }
+
     printf("\n" "--- success ---" "\n");
     return true;
 }